@@ -22,22 +22,13 @@
 #include "buckler.h"
 
 #include "bsp.h"
-#include "app_pwm.h"
+#include "servo.h"
 
 // ADC channels
 #define X_CHANNEL 0
 #define Y_CHANNEL 1
 #define Z_CHANNEL 2
 
-APP_PWM_INSTANCE(PWM1,1);                   // Create the instance "PWM1" using TIMER1.
-
-static volatile bool ready_flag;            // A flag indicating PWM status.
-
-void pwm_ready_callback(uint32_t pwm_id)    // PWM callback function
-{
-    ready_flag = true;
-}
-
 // callback for SAADC events
 void saadc_callback (nrfx_saadc_evt_t const * p_event) {
   // don't care about adc callbacks
@@ -89,26 +80,19 @@ int main (void) {
   // initialization complete
   printf("Buckler initialized!\n");
 
-  ret_code_t err_code;
-
   // initializing servo pin number
   uint8_t SERVO_PIN = 4;
 
-  /* 1-channel PWM, 50Hz, output on DK LED pins, 20ms period */
-  app_pwm_config_t pwm1_cfg = APP_PWM_DEFAULT_CONFIG_1CH(20000L, SERVO_PIN);
-
-  /* Switch the polarity of the first channel. */
-  pwm1_cfg.pin_polarity[0] = APP_PWM_POLARITY_ACTIVE_HIGH;
-
-  /* Initialize and enable PWM. */
-  err_code = app_pwm_init(&PWM1,&pwm1_cfg,NULL);
-  APP_ERROR_CHECK(err_code);
-  app_pwm_enable(&PWM1);
+  // servo on the hardware PWM, 50Hz, 20ms period
+  servo_calibration_t calibration = SERVO_DEFAULT_CALIBRATION;
+  error_code = servo_init(&SERVO_PIN, 1, &calibration);
+  APP_ERROR_CHECK(error_code);
 
-  uint8_t servo_pos_max = 10;
-  uint8_t servo_pos_min = 5;
-  uint8_t servo_stop = 0;
-  uint8_t speed = 0;
+  // pulse widths in us, 0 for no pulses
+  uint16_t servo_pos_max = 2000;
+  uint16_t servo_pos_min = 1000;
+  uint16_t servo_stop = 0;
+  uint16_t speed = 0;
 
   float x_val, y_val, z_val, x_val_g, y_val_g, z_val_g;
   float theta_prev, psi_prev, phi_prev, theta, psi, phi, theta_diff, psi_diff, phi_diff;
@@ -156,8 +140,12 @@ int main (void) {
       speed = servo_stop;
     }
 
-    /* Set the duty cycle - keep trying until PWM is ready... */
-    while (app_pwm_channel_duty_set(&PWM1, 0, speed) == NRF_ERROR_BUSY);
+    // set the pulse width, taking effect at the next servo frame
+    if (speed != servo_stop) {
+      servo_set_pulse_us(0, speed);
+    } else {
+      servo_off(0);
+    }
     nrf_delay_ms(50);
     // while (app_pwm_channel_duty_set(&PWM1, 0, servo_pos_min) == NRF_ERROR_BUSY);
     // nrf_delay_ms(500);
@@ -17,25 +17,12 @@
 #include "buckler.h"
 
 #include "app_error.h"
-#include "app_pwm.h"
 #include "simple_logger.h"
 
+#include "axes.h"
+#include "control.h"
 #include "mpu9250.h"
-
-APP_PWM_INSTANCE(PWM2,2);                   // Create the instance "PWM1" using TIMER1.
-
-static volatile bool ready_flag;            // A flag indicating PWM status.
-
-void pwm_ready_callback(uint32_t pwm_id)    // PWM callback function
-{
-    ready_flag = true;
-}
-
-void set_servo_speed(app_pwm_t const * const p_instance, int speed, int time) {
-  while (app_pwm_channel_duty_set(p_instance, 0, ((double)speed/20)*100.0) == NRF_ERROR_BUSY);
-  nrf_delay_ms(time);
-}
-
+#include "servo.h"
 
 // LED array
 static uint8_t LEDS[3] = {BUCKLER_LED0, BUCKLER_LED1, BUCKLER_LED2};
@@ -43,33 +30,53 @@ static uint8_t LEDS[3] = {BUCKLER_LED0, BUCKLER_LED1, BUCKLER_LED2};
 // I2C manager
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
 
+// rotation state for all axes, in fixed point
+#define ANGLE_SCALE 32.0  // LSBs per degree
+static const int16_t angle_deadband = 3; // about 0.1 degrees per loop
+
+// stabilized axes, indexed by servo channel
+//  channel 0 is SERVO_PIN, channel 1 is SERVO_PIN_TWO
+#define SERVO_AXES 2
+static const uint8_t servo_axis[SERVO_AXES] = {AXIS_Z, AXIS_X};
+
+// stabilization loop per servo axis in Q15, holding the angle plus the servo
+// rotation at zero with the gyro rate as feed-forward. Speeds are in LSBs of
+// full servo speed and angles in ANGLE_SCALE LSBs. There is no servo
+// encoder, so the servo angle is integrated from the profiled speed the
+// servo library outputs.
+#define SPEED_SCALE 32767.0 // LSBs per full servo speed
+static const float servo_full_speed = 600.0; // degrees/second at full speed
+static const float loop_rate_hz = 50.0;      // one loop per servo frame
+
 int main(void) {
-  // servo stuff
-  ret_code_t err_code;
+  ret_code_t error_code = NRF_SUCCESS;
 
   // initializing servo pin number
   uint8_t SERVO_PIN = 3;
   uint8_t SERVO_PIN_TWO = 4;
 
-  /* 1-channel PWM, 50Hz, output on DK LED pins, 20ms period */
-  app_pwm_config_t pwm2_cfg = APP_PWM_DEFAULT_CONFIG_2CH(20000L, SERVO_PIN, SERVO_PIN_TWO);
-
-  //Switch the polarity of the first channel. 
-  pwm2_cfg.pin_polarity[0] = APP_PWM_POLARITY_ACTIVE_HIGH;
-  pwm2_cfg.pin_polarity[1] = APP_PWM_POLARITY_ACTIVE_HIGH;
-
-  /* Initialize and enable PWM. */
-  err_code = app_pwm_init(&PWM2,&pwm2_cfg,NULL);
-  APP_ERROR_CHECK(err_code);
-  app_pwm_enable(&PWM2);
+  // servos on the hardware PWM, 50Hz, 20ms period
+  const uint8_t servo_pins[SERVO_AXES] = {SERVO_PIN, SERVO_PIN_TWO};
+  servo_calibration_t calibration = SERVO_DEFAULT_CALIBRATION;
+  error_code = servo_init(servo_pins, SERVO_AXES, &calibration);
+  APP_ERROR_CHECK(error_code);
 
-  ret_code_t error_code = NRF_SUCCESS;
+  // ramp between commands instead of jumping, so starts and stops do not
+  // jolt the servos and read back as tremor, with the headroom for tremor
+  // explained in servo_stabilization
+  const motion_config_t motion = {
+    .max_velocity = 10000,      // us per second
+    .max_acceleration = 300000, // us per second squared
+  };
+  for (int i = 0; i < SERVO_AXES; i++) {
+    servo_set_motion(i, &motion);
+  }
 
-  //initialize GPIO driver, need to uncomment when app_pwm_init is not there
-  // if (!nrfx_gpiote_is_init()) {
-  //   error_code = nrfx_gpiote_init();
-  // }
-  // APP_ERROR_CHECK(error_code);
+  //initialize GPIO driver
+  if (!nrfx_gpiote_is_init()) {
+    error_code = nrfx_gpiote_init();
+  }
+  APP_ERROR_CHECK(error_code);
 
   
   // initializing printing to sd card
@@ -126,217 +133,81 @@ int main(void) {
   printf("MPU-9250 initialized\n");
 
   // loop forever
-  float x_rot = 0;
-  float y_rot = 0;
-  float z_rot = 0;
-
-  float initial_z = 100.0;
-  float prev_z = 100.0;
-
-  float initial_x = 100.0;
-  float prev_x = 100.0;
-
-  float output;
-  int input, input_start, input_end, output_start, output_end;
+  axes_sum_t angle = {{0}};
 
   int loop_index = 0;
-  int recalibration_count = 0;
-  int z_direction = 0;
-  int x_direction = 0;
-  int prev_z_direction = 100;
-  int prev_x_direction = 100;
+
+  // controller gains converted from servo speed per degree to LSBs per LSB,
+  // the same tuning as servo_stabilization
+  pid_q15_controller_t controller[SERVO_AXES];
+  pid_config_t pid_config = PID_DEFAULT_CONFIG;
+  pid_config.kp = 0.05 * SPEED_SCALE / ANGLE_SCALE;
+  pid_config.ki = 0.5 * SPEED_SCALE / ANGLE_SCALE;
+  pid_config.kd = 0.0005 * SPEED_SCALE / ANGLE_SCALE;
+  pid_config.output_min = -SPEED_SCALE;
+  pid_config.output_max = SPEED_SCALE;
+  pid_config.sample_rate_hz = loop_rate_hz;
+  int32_t servo_turn[SERVO_AXES] = {0}; // angle LSBs with 15 fraction bits
+  // servo rotation per loop at full speed, in angle LSBs
+  const int32_t servo_turn_per_frame = servo_full_speed / loop_rate_hz * ANGLE_SCALE + 0.5f;
+  int16_t speed[SERVO_AXES] = {0};
+  for (int i = 0; i < SERVO_AXES; i++) {
+    pid_q15_init(&controller[i], &pid_config);
+  }
 
   while (1) {
     // blink two LEDs
     nrf_gpio_pin_toggle(LEDS[loop_index%2]);
 
     // get measurements
-    mpu9250_measurement_t acc_measurement = mpu9250_read_accelerometer();
-    mpu9250_measurement_t gyr_measurement = mpu9250_read_gyro();
+    mpu9250_sample_t sample = mpu9250_read_all();
+    mpu9250_measurement_t gyr_measurement = sample.gyro;
+    float rate[AXES_COUNT] = {gyr_measurement.x_axis, gyr_measurement.y_axis, gyr_measurement.z_axis};
 
-    // determine rotation from gyro
+    // determine rotation from gyro for all axes at once over one loop
     // gyros are messy, so only add value if it is of significant magnitude
-    // note that we are dividing by 10 since we are measuring over a tenth of a second
-    float x_rot_amount = gyr_measurement.x_axis/10;
-    if (abs(x_rot_amount) > 0.5) {
-      x_rot += x_rot_amount;
-    }
-    float y_rot_amount = gyr_measurement.y_axis/10;
-    if (abs(y_rot_amount) > 0.5) {
-      y_rot += y_rot_amount;
-    }
-    float z_rot_amount = gyr_measurement.z_axis/10;
-    if (abs(z_rot_amount) > 0.5) {
-      z_rot += z_rot_amount;
-    }
+    float period_s = 1.0 / loop_rate_hz;
+    axes_t delta_angle = axes_quantize(rate[AXIS_X] * period_s, rate[AXIS_Y] * period_s,
+        rate[AXIS_Z] * period_s, ANGLE_SCALE);
+    delta_angle = axes_deadband(delta_angle, angle_deadband);
+    angle = axes_accumulate(angle, delta_angle);
 
     // print results
     // printf("                      X-Axis\t    Y-Axis\t    Z-Axis\n");
     // printf("                  ----------\t----------\t----------\n");
-    // printf("I2C IMU Acc (g): %10.3f\t%10.3f\t%10.3f\n", acc_measurement.x_axis, acc_measurement.y_axis, acc_measurement.z_axis);
+    // printf("I2C IMU Acc (g): %10.3f\t%10.3f\t%10.3f\n", sample.accel.x_axis, sample.accel.y_axis, sample.accel.z_axis);
     // printf("I2C IMU Gyro (g):  %10.3f\t%10.3f\t%10.3f\n", gyr_measurement.x_axis, gyr_measurement.y_axis, gyr_measurement.z_axis);
-    // printf("Angle  (degrees): %10.3f\t%10.3f\t%10.3f\n", x_rot, y_rot, z_rot);
     // printf("\n");
 
-    // simple_logger_log("Acc,%f,%f,%f\n",acc_measurement.x_axis, acc_measurement.y_axis, acc_measurement.z_axis);
-    // simple_logger_log("Gyro,%f,%f,%f\n",gyr_measurement.x_axis, gyr_measurement.y_axis, gyr_measurement.z_axis);
-    // simple_logger_log("Angle,%f,%f,%f\n",x_rot, y_rot, z_rot);
-
-    if (loop_index <= 5) {
-      initial_z = z_rot;
-      prev_z = z_rot;
-      initial_x = x_rot;
-      prev_x = x_rot;
-    }
-
-    if (prev_z != 100.0 && fabsf(prev_z - z_rot) < 0.1) {
-      recalibration_count += 1;
-    }
-
-    if (recalibration_count == 5) {
-      initial_z = z_rot;
-      initial_x = x_rot;
-      recalibration_count = 0;
-    }
-
-    // if (initial_z != 100.0) {
-    //   if (z_rot - initial_z > 40.0) { //cw
-    //     output = 10.0;
-    //   } else if (initial_z - z_rot > 40.0) { //ccw
-    //     output = 6.0;
-    //   } else if (z_rot - initial_z > 3.0) { //cw
-    //     input = z_rot - initial_z;
-    //     input_start = 3;
-    //     input_end = 40;
-    //     output_start = 7.65;
-    //     output_end = 10;
-    //     float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-    //     output = output_start + slope * (input - input_start);
-    //   } else if (initial_z - z_rot > 3.0) { //ccw
-    //     input = initial_z - z_rot;
-    //     input_start = 3;
-    //     input_end = 40;
-    //     output_start = 7.55;
-    //     output_end = 4;
-    //     float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-    //     output = output_start + slope * (input - input_start);
-    //   } 
-    //   else {
-    //     output = 0.0;
-    //   }
-    // } else {
-    //   output = 0.0;
-    // }
-
-    printf("Mapping: %10.3f\t\n", z_rot - prev_z);
-
-  
-    prev_z_direction = 0;
-    if (initial_z != 100.0 && prev_z_direction == 100) {
-      if (z_rot - prev_z < 0) {
-        prev_z_direction = 1;
-      } else if (z_rot - prev_z > 0) {
-        prev_z_direction = 2;
+    // run the controller of every servo axis and drive both servos in one pass
+    for (int i = 0; i < SERVO_AXES; i++) {
+      uint8_t axis = servo_axis[i];
+
+      // advance the servo angle estimate by the profiled speed of this frame,
+      // within the range of the controller input
+      int16_t output = axes_saturate((int32_t)(servo_get_speed(i) * SPEED_SCALE));
+      servo_turn[i] += output * servo_turn_per_frame;
+      if (servo_turn[i] > (int32_t)INT16_MAX << 15) {
+        servo_turn[i] = (int32_t)INT16_MAX << 15;
+      } else if (servo_turn[i] < (int32_t)INT16_MIN * (1 << 15)) {
+        servo_turn[i] = (int32_t)INT16_MIN * (1 << 15);
       }
-    } 
-
-    z_direction = 0;
-    if (prev_z != 100.0) {
-      if (z_rot - prev_z < 0) {
-        z_direction = 1;
-        // CCw
-        if (z_rot - prev_z < -25) {
-          output = 8.2;
-        } else {
-          output = 7.575;
-        }
-      } else if (z_rot - prev_z > 0) {
-        z_direction = 2;
-        // CW
-        if (z_rot - prev_z > 25) {
-          output = 7.25;
-        } else {
-          output = 7.48;
-        }
+      int16_t measurement = axes_saturate(angle.lane[axis] + (servo_turn[i] >> 15));
+      int16_t feedforward = axes_saturate((int32_t)(-rate[axis] / servo_full_speed * SPEED_SCALE));
+      speed[i] = pid_q15_update(&controller[i], 0, measurement, feedforward);
+
+      if (speed[i] != 0) {
+        servo_set_speed(i, speed[i] / SPEED_SCALE);
+      } else {
+        servo_off(i);
       }
     }
 
-
-    // z_direction = 0;
-    // if (initial_z != 100.0) {
-    //   printf("z_rotation: %f\n", z_rot);
-    //   printf("prev_z: %f\n", prev_z);
-    //   printf("diff: %f\n", z_rot-prev_z);
-    //   if (z_rot - prev_z < -20.0) { //cw
-    //     output = 7.8;
-    //   } else if (z_rot - prev_z > 20.0) { //ccw
-    //     output = 7.4;
-    //   } else if (z_rot - prev_z < 0) { //cw
-    //     input = prev_z - z_rot;
-    //     if (input < 10) {
-    //       output = 7.66;
-    //     } else {
-    //       output = 7.8;
-    //     }
-    //     // z_direction = 1;
-    //   } else if (z_rot - prev_z > 0) { //ccw
-    //     input = z_rot - prev_z;
-    //     if (input < 10) {
-    //       output = 7.55;
-    //     } else {
-    //       output = 7.5;
-    //     }
-    //     // z_direction = 2;
-    //   } 
-    // }
-
-//change if statement to say if (output!=0.0) when using output value
-    if (z_direction != 0) {
-      while (app_pwm_channel_duty_set(&PWM2, 0, output) == NRF_ERROR_BUSY);
-      nrf_delay_ms(1);
-    } else {
-      while (app_pwm_channel_duty_set(&PWM2, 0, 0) == NRF_ERROR_BUSY);
-      nrf_delay_ms(1);
+    // sleep until the servo frame that applies the update starts
+    while (servo_update_pending()) {
+      __WFE();
     }
 
-
-    // prev_x_direction = 0;
-    // if (initial_x != 100.0 && prev_x_direction == 100) {
-    //   if (x_rot - initial_x < 0) {
-    //     prev_x_direction = 1;
-    //   } else if (x_rot - initial_x > 0) {
-    //     prev_x_direction = 2;
-    //   }
-    // }
-
-    // x_direction = 0;
-    // if (initial_x != 100.0) {
-    //   if (x_rot - initial_x < 0) {
-    //     x_direction = 1;
-    //   } else if (x_rot - initial_x > 0) {
-    //     x_direction = 2;
-    //   }
-    // }
-
-    // if (x_direction == 1) {
-    //   while (app_pwm_channel_duty_set(&PWM2, 1, 7.655) == NRF_ERROR_BUSY);
-    //   nrf_delay_ms(1);
-    // } else if (x_direction == 2) {
-    //   while (app_pwm_channel_duty_set(&PWM2, 1, 7.598) == NRF_ERROR_BUSY);
-    //   nrf_delay_ms(1);
-    // } else {
-    //   while (app_pwm_channel_duty_set(&PWM2, 1, 0) == NRF_ERROR_BUSY);
-    //   nrf_delay_ms(1);
-    // }
-
-    // while (app_pwm_channel_duty_set(&PWM2, 1, 6.5) == NRF_ERROR_BUSY);
-    // nrf_delay_ms(100);
-    // while (app_pwm_channel_duty_set(&PWM2, 1, 8.5) == NRF_ERROR_BUSY);
-    // nrf_delay_ms(100);
-
-    prev_x_direction = x_direction;
-    prev_z_direction = z_direction;
-    prev_z = z_rot; 
     loop_index++;
   }
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 
 #include "app_error.h"
 #include "app_timer.h"
-#include "app_pwm.h"
+#include "app_util_platform.h"
 
 #include "nrf.h"
 #include "nrf_delay.h"
@@ -18,19 +18,20 @@
 #include "nrfx_saadc.h"
 #include "nrfx_twim.h"
 
+#include "axes.h"
 #include "buckler.h"
+#include "control.h"
+#include "kalman.h"
+#include "latency.h"
 #include "mpu9250.h"
+#include "servo.h"
 #include "simple_logger.h"
+#include "spectrum.h"
+#include "telemetry.h"
+#include "tremor_detect.h"
+#include "tremor_freq.h"
 #include "virtual_timer.h"
-
-APP_PWM_INSTANCE(PWM2,2);                   // Create the instance "PWM1" using TIMER1.
-
-static volatile bool ready_flag;            // A flag indicating PWM status.
-
-void pwm_ready_callback(uint32_t pwm_id)    // PWM callback function
-{
-    ready_flag = true;
-}
+#include "wflc.h"
 
 // static volatile bool volun_flag; 
 // void pin_change_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
@@ -47,41 +48,329 @@ static uint8_t LEDS[3] = {BUCKLER_LED0, BUCKLER_LED1, BUCKLER_LED2};
 // I2C manager
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
 
-// flag to poll
-static volatile bool poll_flag = false;
+// sample period, paced by the IMU data-ready interrupt
+static const uint32_t poll_period = 20; // in ms
+
+// newest IMU sample, handed over from the read completion interrupt
+static volatile bool sample_ready = false;
+static mpu9250_sample_t ready_sample;
+static uint32_t ready_time;
+static uint32_t samples_overwritten = 0;
+
+// rotation state for all axes, in fixed point
+//  per-period rotations are quantized finely enough that rounding does not
+//  drift the angle, and still fit an int16 lane at the 2000 degree/second
+//  gyro range. The angle itself is kept in int32 lanes, over 11000 turns
+#define ANGLE_SCALE 512.0  // LSBs per degree
+//  rates below the deadband are gyro noise, dropped as rotation per period
+static const float gyro_deadband = 0.5; // degrees/second
+static axes_sum_t angle = {{0}};
+
+// gyro zero-rate offset, as rotation per period at ANGLE_SCALE, taken out of
+// every sample before the deadband. Learned over the startup hold from the
+// samples still enough to be offset rather than motion, which also bounds
+// their sum well inside an int16 lane
+#define OFFSET_SAMPLES 25                // startup hold, half a second
+static const float offset_still = 10.0;  // degrees/second, faster is motion
+static axes_t offset_sum = {{0}};
+static int offset_count = 0;
+static axes_t gyro_offset = {{0}};
+
+static int loop_index = 0;
+
+// stabilized axes, indexed by servo channel
+//  channel 0 is SERVO_PIN, channel 1 is SERVO_PIN_TWO
+#define SERVO_AXES 2
+static const uint8_t servo_axis[SERVO_AXES] = {AXIS_Z, AXIS_X};
+
+// band-pass energy tremor detector on each servo axis gyro rate
+static tremor_detect_t detector[SERVO_AXES];
+static bool tremor_active[SERVO_AXES];
+
+// adaptive tremor frequency tracker per servo axis
+static wflc_t wflc[SERVO_AXES];
+
+// oscillator plus drift model fusing gyro rate and integrated angle, used to
+// drive the servo against where the tremor will be once the command takes
+// effect rather than where it was
+static kalman_t kalman[SERVO_AXES];
+static const float servo_latency = 0.04; // in seconds, sensor read to servo motion
+
+// tremor cancellation loop per servo axis, driving the servo speed so its
+// rotation plus the predicted tremor angle stays at zero, with the tremor
+// rate as feed-forward. There is no servo encoder, so the servo angle is
+// integrated from the profiled speed the servo library outputs. Gains tuned
+// with tools/pid_sim, which runs this loop through the same predictor and
+// motion profile.
+static pid_controller_t controller[SERVO_AXES];
+static const float servo_full_speed = 600.0; // degrees/second at full speed
+static float servo_angle[SERVO_AXES];        // in degrees
+static float speed[SERVO_AXES];              // -1 to 1, 0 for off
+
+// sliding DFT tracking the dominant z tremor frequency, updated every tick
+static tremor_freq_t z_spectrum;
+static tremor_freq_result_t z_tremor;
+static uint32_t spectrum_cycles_max = 0;  // worst case update cost, CPU cycles
+
+// power spectral density of the last PSD_SIZE z gyro rates, about ten
+// seconds at the polling rate, recomputed for each report. The FFT and PSD
+// are timed in CPU cycles like the sliding DFT
+#define PSD_SIZE SPECTRUM_MAX_SIZE
+static int16_t psd_rates[PSD_SIZE];  // at TELEMETRY_GYRO_SCALE, oldest at psd_next once full
+static uint32_t psd_next = 0;
+static int16_t psd_fft[PSD_SIZE];
+static float psd[PSD_SIZE / 2 + 1];
+static float psd_peak_hz = 0;
+static float psd_band_power = 0;
+static uint32_t rfft_cycles_max = 0;
+static uint32_t psd_cycles_max = 0;
+
+// an IMU read scheduled by the data-ready interrupt has completed. Runs in
+// the twi manager interrupt, so only hand the sample to the main loop. The
+// driver marks the read start at the data-ready edge
+static void imu_sample_ready(mpu9250_sample_t sample) {
+  LATENCY_MARK(LATENCY_READ_END);
+  if (sample_ready) {
+    samples_overwritten++;
+  }
+  ready_sample = sample;
+  ready_time = read_timer();
+  sample_ready = true;
+}
+
+// one control step: update tremor detection from an IMU sample, and drive
+// the servos. Runs from the main loop for each sample, every poll_period
+static void control_tick(mpu9250_sample_t sample, uint32_t sample_time) {
+  // cycle the three LEDs
+  nrf_gpio_pin_toggle(LEDS[loop_index%3]);
+
+  mpu9250_measurement_t acc_measurement = sample.accel;
+  mpu9250_measurement_t gyr_measurement = sample.gyro;
+  float rate[AXES_COUNT] = {gyr_measurement.x_axis, gyr_measurement.y_axis, gyr_measurement.z_axis};
+
+  // determine rotation from gyro for all axes at once
+  // gyros are messy, so only add rotation if it is of significant magnitude
+  float period_s = poll_period / 1000.0;
+  int16_t angle_deadband = gyro_deadband * period_s * ANGLE_SCALE + 0.5f;
+  axes_t delta_angle = axes_quantize(rate[AXIS_X] * period_s, rate[AXIS_Y] * period_s,
+      rate[AXIS_Z] * period_s, ANGLE_SCALE);
+  if (loop_index < OFFSET_SAMPLES) {
+    int32_t still = offset_still * period_s * ANGLE_SCALE;
+    if (axes_dot(delta_angle, delta_angle) <= still * still) {
+      offset_sum = axes_add(offset_sum, delta_angle);
+      offset_count++;
+    }
+    if (loop_index == OFFSET_SAMPLES - 1 && offset_count > 0) {
+      gyro_offset = axes_quantize(offset_sum.lane[AXIS_X], offset_sum.lane[AXIS_Y],
+          offset_sum.lane[AXIS_Z], 1.0 / offset_count);
+    }
+  }
+  delta_angle = axes_sub(delta_angle, gyro_offset);
+  delta_angle = axes_deadband(delta_angle, angle_deadband);
+  angle = axes_accumulate(angle, delta_angle);
+
+  // run the tremor pipeline for every servo axis in one pass
+  for (int i = 0; i < SERVO_AXES; i++) {
+    uint8_t axis = servo_axis[i];
+
+    // detect tremor from the energy in the 3-12 Hz band of the gyro rate, so
+    // slow voluntary motion does not trigger stabilization
+    tremor_active[i] = tremor_detect_update(&detector[i], rate[axis]);
+
+    // track the tremor frequency and run the oscillator model at it
+    wflc_update(&wflc[i], rate[axis]);
+    kalman_set_frequency(&kalman[i], wflc_frequency_hz(&wflc[i]));
+    kalman_update(&kalman[i], axes_sum_get(angle, axis, ANGLE_SCALE), rate[axis]);
+
+    // hold the servo while there is no tremor to cancel, and until the
+    // gyro offset is learned after startup
+    if (!tremor_active[i] || loop_index < OFFSET_SAMPLES) {
+      pid_reset(&controller[i]);
+      servo_angle[i] = 0;
+      speed[i] = 0;
+      continue;
+    }
+
+    // counter the tremor motion predicted at t + servo_latency, from where
+    // the last command has turned the servo to
+    kalman_prediction_t predicted = kalman_predict(&kalman[i], servo_latency);
+    servo_angle[i] += servo_get_speed(i) * servo_full_speed * period_s;
+    speed[i] = pid_update(&controller[i], 0, predicted.tremor_angle + servo_angle[i],
+        -predicted.tremor_rate / servo_full_speed);
+  }
+  LATENCY_MARK(LATENCY_COMPUTED);
+
+  // track tremor frequency, timing the update against the control period
+  uint32_t start_cycles = DWT->CYCCNT;
+  tremor_freq_update(&z_spectrum, rate[AXIS_Z]);
+  z_tremor = tremor_freq_result(&z_spectrum);
+  uint32_t cycles = DWT->CYCCNT - start_cycles;
+  if (cycles > spectrum_cycles_max) {
+    spectrum_cycles_max = cycles;
+  }
+
+  // drive both servos from the same pass, taking effect at the next frame
+  for (int i = 0; i < SERVO_AXES; i++) {
+    if (speed[i] != 0) {
+      servo_set_speed(i, speed[i]);
+    } else {
+      servo_off(i);
+    }
+  }
+  LATENCY_COMMIT(servo_update_count());
+
+  // queue the step for the main loop to send, instead of printing it here
+  telemetry_record_t record = {
+    .timestamp_us = sample_time,
+    .gyro = {
+      telemetry_quantize(rate[AXIS_X], TELEMETRY_GYRO_SCALE),
+      telemetry_quantize(rate[AXIS_Y], TELEMETRY_GYRO_SCALE),
+      telemetry_quantize(rate[AXIS_Z], TELEMETRY_GYRO_SCALE),
+    },
+    .accel = {
+      telemetry_quantize(acc_measurement.x_axis, TELEMETRY_ACCEL_SCALE),
+      telemetry_quantize(acc_measurement.y_axis, TELEMETRY_ACCEL_SCALE),
+      telemetry_quantize(acc_measurement.z_axis, TELEMETRY_ACCEL_SCALE),
+    },
+    .angle = {
+      telemetry_quantize(axes_sum_get(angle, AXIS_X, ANGLE_SCALE), TELEMETRY_ANGLE_SCALE),
+      telemetry_quantize(axes_sum_get(angle, AXIS_Y, ANGLE_SCALE), TELEMETRY_ANGLE_SCALE),
+      telemetry_quantize(axes_sum_get(angle, AXIS_Z, ANGLE_SCALE), TELEMETRY_ANGLE_SCALE),
+    },
+  };
+  for (int i = 0; i < SERVO_AXES; i++) {
+    record.tremor |= tremor_active[i] << i;
+    record.command[i] = telemetry_quantize(speed[i], TELEMETRY_COMMAND_SCALE);
+  }
+  telemetry_write(&record);
+  psd_rates[psd_next % PSD_SIZE] = record.gyro[AXIS_Z];
+  psd_next++;
+
+  loop_index++;
+}
+
+// PSD of the z rate window once it is full. Like tools/tremor_psd, the
+// window is scaled so its largest deviation from the mean uses half of the
+// int16 range, since the FFT output is scaled down by its size
+static void update_psd(void) {
+  if (psd_next < PSD_SIZE) {
+    return;
+  }
+
+  int32_t sum = 0;
+  for (int i = 0; i < PSD_SIZE; i++) {
+    sum += psd_rates[i];
+  }
+  int32_t mean = sum / PSD_SIZE;
+  int32_t peak = 1;
+  for (int i = 0; i < PSD_SIZE; i++) {
+    int32_t deviation = psd_rates[i] - mean;
+    if (deviation > peak || -deviation > peak) {
+      peak = (deviation > 0) ? deviation : -deviation;
+    }
+  }
+  float gain = 16384.0f / peak;
+  for (int i = 0; i < PSD_SIZE; i++) {
+    psd_fft[i] = (psd_rates[(psd_next + i) % PSD_SIZE] - mean) * gain;
+  }
+  spectrum_hann(psd_fft, PSD_SIZE);
+
+  float sample_rate_hz = 1000.0 / poll_period;
+  uint32_t start_cycles = DWT->CYCCNT;
+  spectrum_rfft(psd_fft, PSD_SIZE);
+  uint32_t cycles = DWT->CYCCNT - start_cycles;
+  if (cycles > rfft_cycles_max) {
+    rfft_cycles_max = cycles;
+  }
+  start_cycles = DWT->CYCCNT;
+  spectrum_psd(psd_fft, PSD_SIZE, sample_rate_hz, TELEMETRY_GYRO_SCALE * gain, psd);
+  cycles = DWT->CYCCNT - start_cycles;
+  if (cycles > psd_cycles_max) {
+    psd_cycles_max = cycles;
+  }
+
+  // peak and power in the 3-12 Hz tremor band
+  int peak_bin = 1;
+  psd_band_power = 0;
+  for (int k = 1; k <= PSD_SIZE / 2; k++) {
+    float hz = spectrum_bin_hz(k, PSD_SIZE, sample_rate_hz);
+    if (hz >= 3.0 && hz <= 12.0) {
+      psd_band_power += psd[k] * sample_rate_hz / PSD_SIZE;
+    }
+    if (psd[k] > psd[peak_bin]) {
+      peak_bin = k;
+    }
+  }
+  psd_peak_hz = spectrum_bin_hz(peak_bin, PSD_SIZE, sample_rate_hz);
+}
 
-// polling callback function
-void poll() {
-  poll_flag = true;
+#if LATENCY_ENABLED
+// a servo frame has started, playing every update up to update. The
+// profiled servos take their first step toward an update at the frame
+// boundary after it is written, so this is up to two frames after the commit
+static void servo_frame(uint32_t frame, uint32_t update) {
+  LATENCY_APPLY(update);
+}
+#endif
+
+// print how much of the time the cpu spent asleep
+static void report_idle(void) {
+  uint32_t idle_percent, wakeups_per_second;
+  virtual_timer_idle_stats(&idle_percent, &wakeups_per_second);
+  printf("Idle: %lu%%, wakeups/s: %lu, telemetry dropped: %lu\n", idle_percent, wakeups_per_second,
+      telemetry_dropped());
+  printf("IMU samples missed: %lu, overwritten: %lu\n", mpu9250_data_ready_missed(), samples_overwritten);
+  if (tremor_freq_ready(&z_spectrum)) {
+    printf("Tremor: %.2f Hz, band power: %.1f, spectrum cycles max: %lu\n",
+        z_tremor.peak_hz, z_tremor.band_power, spectrum_cycles_max);
+    printf("WFLC: %.2f Hz, amplitude: %.1f\n", wflc_frequency_hz(&wflc[0]), wflc_amplitude(&wflc[0]));
+  }
+  update_psd();
+  if (psd_next >= PSD_SIZE) {
+    printf("PSD: peak %.2f Hz, band power: %.1f, %d point cycles max: rfft %lu, psd %lu\n",
+        psd_peak_hz, psd_band_power, PSD_SIZE, rfft_cycles_max, psd_cycles_max);
+  }
+#if LATENCY_ENABLED
+  latency_print();
+#endif
 }
 
 int main(void) {
-  // servo stuff
-  ret_code_t err_code;
+  ret_code_t error_code = NRF_SUCCESS;
 
   // initializing servo pin number
   uint8_t SERVO_PIN = 3;
   uint8_t SERVO_PIN_TWO = 4;
 
-  /* 1-channel PWM, 50Hz, output on DK LED pins, 20ms period */
-  app_pwm_config_t pwm2_cfg = APP_PWM_DEFAULT_CONFIG_2CH(20000L, SERVO_PIN, SERVO_PIN_TWO);
-
-  //Switch the polarity of the first channel. 
-  pwm2_cfg.pin_polarity[0] = APP_PWM_POLARITY_ACTIVE_HIGH;
-  pwm2_cfg.pin_polarity[1] = APP_PWM_POLARITY_ACTIVE_HIGH;
-
-  /* Initialize and enable PWM. */
-  err_code = app_pwm_init(&PWM2,&pwm2_cfg,NULL);
-  APP_ERROR_CHECK(err_code);
-  app_pwm_enable(&PWM2);
+  // servos on the hardware PWM, 50Hz, 20ms period
+  // microservos stand still at about 1512 us
+  const uint8_t servo_pins[SERVO_AXES] = {SERVO_PIN, SERVO_PIN_TWO};
+  servo_calibration_t calibration = SERVO_DEFAULT_CALIBRATION;
+  calibration.stop_us = 1512;
+  calibration.deadband_us = 4;
+  error_code = servo_init(servo_pins, SERVO_AXES, &calibration);
+  APP_ERROR_CHECK(error_code);
 
-  ret_code_t error_code = NRF_SUCCESS;
+  // ramp between commands instead of jumping, so starts and stops do not
+  // jolt the servos and read back as tremor. A command of amplitude A at f
+  // needs A*(2*pi*f)^2 of acceleration, and countering 2 degrees at 8 Hz with
+  // a 600 degree/second servo is about 80 us at 8 Hz, or 200000 us/s^2. When
+  // the profile cannot follow, the servo angle wanders instead of cancelling
+  // (tools/pid_sim), so the limits leave headroom above that and only shape
+  // larger steps, such as from stop to full speed
+  const motion_config_t motion = {
+    .max_velocity = 10000,      // us per second
+    .max_acceleration = 300000, // us per second squared
+  };
+  for (int i = 0; i < SERVO_AXES; i++) {
+    servo_set_motion(i, &motion);
+  }
 
-  // initialize GPIO driver, need to uncomment when app_pwm_init is not there
-  // if (!nrfx_gpiote_is_init()) {
-  //   error_code = nrfx_gpiote_init();
-  // }
-  // APP_ERROR_CHECK(error_code);
+  // initialize GPIO driver
+  if (!nrfx_gpiote_is_init()) {
+    error_code = nrfx_gpiote_init();
+  }
+  APP_ERROR_CHECK(error_code);
 
   
   // // initializing printing to sd card
@@ -128,6 +417,7 @@ int main(void) {
   error_code = NRF_LOG_INIT(NULL);
   APP_ERROR_CHECK(error_code);
   NRF_LOG_DEFAULT_BACKENDS_INIT();
+  telemetry_rtt_init();
   printf("Log initialized!\n");
 
   // initialize i2c master (two wire interface)
@@ -142,325 +432,68 @@ int main(void) {
   mpu9250_init(&twi_mngr_instance);
   printf("MPU-9250 initialized\n");
 
+  // initialize the tremor pipeline for the polling rate
+  tremor_detect_config_t detect_config = TREMOR_DETECT_DEFAULT_CONFIG;
+  detect_config.sample_rate_hz = 1000.0 / poll_period;
+  wflc_config_t wflc_config = WFLC_DEFAULT_CONFIG;
+  wflc_config.sample_rate_hz = detect_config.sample_rate_hz;
+  kalman_config_t kalman_config = KALMAN_DEFAULT_CONFIG;
+  kalman_config.sample_rate_hz = detect_config.sample_rate_hz;
+  for (int i = 0; i < SERVO_AXES; i++) {
+    tremor_detect_init(&detector[i], &detect_config);
+    wflc_init(&wflc[i], &wflc_config);
+    kalman_init(&kalman[i], &kalman_config);
+  }
+  pid_config_t pid_config = PID_DEFAULT_CONFIG;
+  pid_config.kp = 0.05;    // servo speed per degree
+  pid_config.ki = 0.5;     // per degree second
+  pid_config.kd = 0.0005;  // per degree/second
+  pid_config.sample_rate_hz = detect_config.sample_rate_hz;
+  for (int i = 0; i < SERVO_AXES; i++) {
+    pid_init(&controller[i], &pid_config);
+  }
+  tremor_freq_init(&z_spectrum, detect_config.sample_rate_hz, 3.0, 15.0);
+
+  // enable the cycle counter used to time the spectral analysis
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   // initialize timer library
   virtual_timer_init();
+#if LATENCY_ENABLED
+  latency_init();
+  servo_set_frame_callback(servo_frame);
+#endif
   nrf_delay_ms(1000);
 
-  // polling period
-  uint32_t poll_period = 20; // in ms
-
-  // loop forever
-  // float x_rot = 0;
-  // float y_rot = 0;
-  float z_rot = 0;
-
-  float initial_z = 100.0;
-  float prev_z = 100.0;
-
-  // float initial_x = 100.0;
-  // float prev_x = 100.0;
-
-  float output = 0.0;
-  // float x_output = 0.0;
-  float input, input_start, input_end, output_start, output_end;
-
-  int loop_index = 0;
-  int recalibration_count = 0;
-  int z_direction = 0;
-  // int x_direction = 0;
-  int prev_z_direction = 100;
-  // int prev_x_direction = 100;
-
-  int tremor_count = 0;
-  int time_count = 0;
-  int same_direction_count = 0;
-
-  int threshold = 4;
-  int period_count = 50;
-  bool volun_flag = false;
-
-  // start polling timer in microsec
-  virtual_timer_start_repeated(poll_period * 1000, poll);
-
-  while (1) {     // (loop_index < 100000) for certain time
-    // blink two LEDs
-    nrf_gpio_pin_toggle(LEDS[loop_index%3]);
-
-    if (poll_flag) {
-      // get measurements
-      mpu9250_measurement_t acc_measurement = mpu9250_read_accelerometer();
-      mpu9250_measurement_t gyr_measurement = mpu9250_read_gyro();
-
-      // determine rotation from gyro
-      // gyros are messy, so only add value if it is of significant magnitude
-      // note that we are dividing by 10 since we are measuring over a tenth of a second
-      // float x_rot_amount = gyr_measurement.x_axis * poll_period / 1000.00;
-      // if (x_rot_amount > 0.05 || x_rot_amount < -0.05) {
-      //   x_rot += x_rot_amount;
-      // }
-      // float y_rot_amount = gyr_measurement.y_axis * poll_period / 1000.00;
-      // if (y_rot_amount > 0.05 || y_rot_amount < -0.05) {
-      //   y_rot += y_rot_amount;
-      // }
-      float z_rot_amount = gyr_measurement.z_axis * poll_period / 1000.00;
-      if (z_rot_amount > 0.1 || z_rot_amount < -0.1) {
-        z_rot += z_rot_amount;
-      }
-
-      // print results
-      printf("                      Z-Axis\n");
-      printf("                  ----------\n");
-      printf("I2C IMU Acc  (g): %10.3f\n", acc_measurement.z_axis);
-      printf("I2C IMU Gyro (g): %10.3f\n", gyr_measurement.z_axis);
-      printf("Angle  (degrees): %10.3f\n", z_rot);
-      printf("\n");
-      // printf("                      X-Axis\t    Y-Axis\t    Z-Axis\n");
-      // printf("                  ----------\t----------\t----------\n");
-      // printf("I2C IMU Acc (g): %10.3f\t%10.3f\t%10.3f\n", acc_measurement.x_axis, acc_measurement.y_axis, acc_measurement.z_axis);
-      // printf("I2C IMU Gyro (g):  %10.3f\t%10.3f\t%10.3f\n", gyr_measurement.x_axis, gyr_measurement.y_axis, gyr_measurement.z_axis);
-      // printf("Angle  (degrees): %10.3f\t%10.3f\t%10.3f\n", x_rot, y_rot, z_rot);
-      // printf("\n");
-
-      // simple_logger_log("Acc,%f,%f,%f\n",acc_measurement.x_axis, acc_measurement.y_axis, acc_measurement.z_axis);
-      // simple_logger_log("Gyro,%f,%f,%f\n",gyr_measurement.x_axis, gyr_measurement.y_axis, gyr_measurement.z_axis);
-      // simple_logger_log("Angle,%f,%f,%f\n",x_rot, y_rot, z_rot);
-
-      
-      if (loop_index <= 5) {
-        initial_z = z_rot;
-        prev_z = z_rot;
-        // initial_x = x_rot;
-        // prev_x = x_rot;
-      }
-
-      // if (prev_z != 100.0 && fabsf(prev_z - z_rot) < 5.0) {
-      //   recalibration_count += 1;
-      // }
-
-      // if (recalibration_count > 25 && tremor_count < 5) {
-      //   initial_z = z_rot;
-      //   initial_x = x_rot;   
-      //   recalibration_count = 0;
-      // }
-
-
-      // if (initial_z - z_rot > 40.0) { //cw
-      //   output = 10.0;
-      // } else if (z_rot - initial_z > 40.0) { //ccw
-      //   output = 5.0;
-      // } else if (initial_z - z_rot > 0) { //cw
-      //   input = z_rot - initial_z;
-      //   input_start = 0;
-      //   input_end = 40;
-      //   output_start = 7.5;
-      //   output_end = 10;
-      //   float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-      //   output = output_start + slope * (input - input_start);
-      // } else if (z_rot - initial_z > 0) { //ccw
-      //   input = initial_z - z_rot;
-      //   input_start = 0;   
-      //   input_end = 40;
-      //   output_start = 7.5;
-      //   output_end = 5;
-      //   float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-      //   output = output_start + slope * (input - input_start);
-      // } else {
-      //   output = 0.0;
-      // }
-
-      // printf("Mapping: %f", output);
-      
-      if (initial_z != 100.0 && prev_z_direction == 100) {
-        if (z_rot - initial_z < 0) {
-          prev_z_direction = 1;  // CW
-        } else if (z_rot - initial_z > 0) {
-          prev_z_direction = 2;  // CCW
-        }
-      }
-
-      // z_direction = 0;
-      // if (initial_z != 100.0) {
-      //   if (z_rot - initial_z < 0) {
-      //     z_direction = 1;
-      //   } else if (z_rot - initial_z > 0) {
-      //     z_direction = 2;  
-      //   }
-      // }
-
-      z_direction = 0;
-      if (initial_z != 100.0) {
-        if (z_rot - prev_z < -20.0) { //cw
-          output = 7.8;
-        } else if (z_rot - prev_z > 20.0) { //ccw
-          output = 7.3;
-        } else if (z_rot - prev_z < -1.0) { //cw
-          input = prev_z - z_rot;
-          if (input < 4) {
-            output = 7.57;
-          } else {
-            input_start = 2;
-            input_end = 20;
-            output_start = 7.57;
-            output_end = 7.8;
-            float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-            output = output_start + slope * (input - input_start);
-          }
-          z_direction = 1;
-        } else if (z_rot - prev_z > 1.0) { //ccw
-          input = z_rot - prev_z;
-          if (input < 4) {
-            output = 7.555;
-          } else {
-            input_start = 2;
-            input_end = 20;
-            output_start = 7.54;
-            output_end = 7.3;
-            float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-            output = output_start + slope * (input - input_start);
-          }
-          z_direction = 2;
-        } 
-      }
-
-      // z_direction = 0;
-      // float diff = z_rot - prev_z;
-      // if (initial_z != 100.0) {
-      //   if (diff < -20 || diff > 20) {
-      //     if (diff > 0)
-      //   }
-      // }
-
-      // printf("z_direction: %d\n", z_direction);    
-      // printf("prev_z_direction: %d\n", prev_z_direction); 
-      // printf("difference: %f\n", z_rot-prev_z); 
-      // printf("output: %f\n", output);
-
-
-      if ((z_direction == 1 && prev_z_direction != 1)) {
-        if (tremor_count < 10) {
-          tremor_count++;
-        }
-      }
-
-      if ((z_direction == 1 && prev_z_direction == 1) || (z_direction == 2 && prev_z_direction == 2)) {
-        same_direction_count++;
-      } else {
-        same_direction_count = 0;
-      }
-
-      if (same_direction_count > 50) {
-        tremor_count = 0;
-        same_direction_count = 0;
-        volun_flag = false;
-      }
-
-      // if (fabsf(initial_z - z_rot) > 100.0) {
-      //   tremor_count = 0;
-      //   recalibration_count = 0;
-
-      // }
-      if (tremor_count >= threshold && time_count < period_count) {
-        volun_flag = true;
-      } else if (tremor_count < threshold && time_count >= period_count) {
-        volun_flag = false;
-        time_count = 0;
-        tremor_count = 0;
-        
-      }
-
-      if (time_count >= period_count) {
-        time_count = 0;
-        // tremor_count = 0;
-        if (tremor_count - 3 >= 0) {
-          tremor_count = tremor_count - 3;
-        } else {
-          tremor_count = 0;
-        }
-      }
-
-      // printf("tremor_count: %d\n", tremor_count);    
-      // printf("time_count: %d\n", time_count); 
-      // printf("volun_flag: %d\n", volun_flag); 
-      
-      poll_flag = false;
-    }
+  // initialize power management for the idle loop
+  error_code = nrf_pwr_mgmt_init();
+  APP_ERROR_CHECK(error_code);
 
-    printf("Z: %x\n", z_direction);
-    // printf("Prev Z: %x\n", prev_z_direction);
-    if (z_direction == 1) { // microservo is between 5 and 10
-      while (app_pwm_channel_duty_set(&PWM2, 0, 7.65) == NRF_ERROR_BUSY);
-      nrf_delay_ms(2);
-      printf("Direction 111111111111111111111");
-    } else if (z_direction == 2) {
-      while (app_pwm_channel_duty_set(&PWM2, 7.45, output) == NRF_ERROR_BUSY);
-      nrf_delay_ms(2);
-      printf("Direction 2222222222222222222222");
-    } else {
-      while (app_pwm_channel_duty_set(&PWM2, 0, 0) == NRF_ERROR_BUSY);
-      nrf_delay_ms(2);
+  // run reporting from the main loop, not the interrupt
+  virtual_timer_start_repeated_deferred(1000000, report_idle);
+
+  // each data-ready edge from the IMU schedules a non-blocking read, so the
+  // IMU paces the control loop and the CPU sleeps through the transfer
+  error_code = mpu9250_start_data_ready(BUCKLER_IMU_INTERUPT, 1000 / poll_period, imu_sample_ready);
+  APP_ERROR_CHECK(error_code);
+
+  // sleep until an interrupt, then run the control step for a new sample and
+  // whatever timers became due, and send the telemetry they queued
+  while (1) {
+    if (sample_ready) {
+      CRITICAL_REGION_ENTER();
+      mpu9250_sample_t sample = ready_sample;
+      uint32_t sample_time = ready_time;
+      sample_ready = false;
+      CRITICAL_REGION_EXIT();
+      control_tick(sample, sample_time);
+    }
+    virtual_timer_dispatch();
+    telemetry_drain(telemetry_rtt_sink);
+    if (!sample_ready) {
+      virtual_timer_idle();
     }
-    printf("Time: %d\n\n", read_timer());
-
-
-    // if (initial_x != 100.0 && prev_x_direction == 100) {
-    //   if (x_rot - initial_x < 0) {
-    //     prev_x_direction = 1;
-    //   } else if (x_rot - initial_x > 0) {
-    //     prev_x_direction = 2;
-    //   }
-    // }
-
-    // x_direction = 0;
-    // if (initial_x != 100.0) {
-    //   if (x_rot - initial_x < 0) {
-    //     x_direction = 1;
-    //   } else if (x_rot - initial_x > 0) {
-    //     x_direction = 2;
-    //   }
-    // }
-
-    // if (initial_x - x_rot > 40.0) { //cw
-    //   x_output = 10.0;
-    // } else if (x_rot - initial_x > 40.0) { //ccw
-    //   x_output = 5.0;
-    // } else if (initial_x - x_rot > 0) { //cw
-    //   input = x_rot - initial_x;
-    //   input_start = 0;
-    //   input_end = 40;
-    //   output_start = 7.5;
-    //   output_end = 10;
-    //   float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-    //   x_output = output_start + slope * (input - input_start);
-    // } else if (x_rot - initial_x > 0) { //ccw
-    //   input = initial_x - x_rot;
-    //   input_start = 0;   
-    //   input_end = 40;
-    //   output_start = 7.5;
-    //   output_end = 5;
-    //   float slope = 1.0 * (output_end - output_start)/(input_end - input_start);
-    //   x_output = output_start + slope * (input - input_start);
-    // } else {
-    //   x_output = 0.0;
-    // }
-
-    // // printf("X: %x\n", x_direction);
-    // // printf("Prev X: %x\n", prev_x_direction);
-    // if (x_output != 0.0 && volun_flag == true) {
-    //   while (app_pwm_channel_duty_set(&PWM2, 1, x_output) == NRF_ERROR_BUSY);
-    //   nrf_delay_ms(10);
-    
-    // // else if (x_direction == 2) {
-    // //   while (app_pwm_channel_duty_set(&PWM2, 1, 7.9) == NRF_ERROR_BUSY);
-    // //   nrf_delay_ms(10);
-    // } else {
-    //   while (app_pwm_channel_duty_set(&PWM2, 1, 0) == NRF_ERROR_BUSY);
-    //   nrf_delay_ms(10);
-    // }
-
-    time_count++;
-    // prev_x_direction = x_direction;
-    prev_z_direction = z_direction;
-    prev_z = z_rot; 
-    loop_index++;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,144 @@
+// Three-axis fixed-point vectors
+//
+// Structure-of-arrays helpers so x, y, and z move through the processing core
+// together instead of as hand-duplicated scalar code. Each per-sample axis is
+// an int16 lane, padded to four lanes so pairs of axes share a 32-bit word.
+// On cores with the DSP extension each word is handled by one SIMD
+// instruction (QADD16, QSUB16, SMLAD); elsewhere the fixed-length lane loops
+// are left for the compiler to vectorize. Sums over many samples, such as an
+// angle integrated from gyro rates, are kept in int32 lanes so they neither
+// saturate nor need a coarse scale.
+//
+// The padding lane is always zero, so it never affects results.
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define AXES_SIMD 1
+#include "nrf.h" // CMSIS SIMD intrinsics
+#else
+#define AXES_SIMD 0
+#endif
+
+// Configuration
+
+#define AXES_COUNT 3
+#define AXES_LANES 4
+
+// Types
+
+enum {
+  AXIS_X = 0,
+  AXIS_Y,
+  AXIS_Z,
+};
+
+typedef union {
+  int16_t lane[AXES_LANES];
+  uint32_t pair[AXES_LANES / 2];
+} axes_t;
+
+// accumulator of axes_t samples at the same scale
+typedef struct {
+  int32_t lane[AXES_LANES];
+} axes_sum_t;
+
+
+// Functions
+
+static inline int16_t axes_saturate(int32_t value) {
+  if (value > INT16_MAX) {
+    return INT16_MAX;
+  } else if (value < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)value;
+}
+
+// Quantize a three-axis float sample
+//
+// scale - LSBs per input unit
+static inline axes_t axes_quantize(float x, float y, float z, float scale) {
+  axes_t result = {{
+    axes_saturate((int32_t)(x * scale + (x < 0 ? -0.5f : 0.5f))),
+    axes_saturate((int32_t)(y * scale + (y < 0 ? -0.5f : 0.5f))),
+    axes_saturate((int32_t)(z * scale + (z < 0 ? -0.5f : 0.5f))),
+    0,
+  }};
+  return result;
+}
+
+// Return one axis converted back to input units
+static inline float axes_get(axes_t value, int axis, float scale) {
+  return value.lane[axis] / scale;
+}
+
+// Saturating per-axis a + b
+static inline axes_t axes_add(axes_t a, axes_t b) {
+  axes_t result;
+#if AXES_SIMD
+  for (int i = 0; i < AXES_LANES / 2; i++) {
+    result.pair[i] = __QADD16(a.pair[i], b.pair[i]);
+  }
+#else
+  for (int i = 0; i < AXES_LANES; i++) {
+    result.lane[i] = axes_saturate((int32_t)a.lane[i] + b.lane[i]);
+  }
+#endif
+  return result;
+}
+
+// Saturating per-axis a - b
+static inline axes_t axes_sub(axes_t a, axes_t b) {
+  axes_t result;
+#if AXES_SIMD
+  for (int i = 0; i < AXES_LANES / 2; i++) {
+    result.pair[i] = __QSUB16(a.pair[i], b.pair[i]);
+  }
+#else
+  for (int i = 0; i < AXES_LANES; i++) {
+    result.lane[i] = axes_saturate((int32_t)a.lane[i] - b.lane[i]);
+  }
+#endif
+  return result;
+}
+
+// Zero every axis whose magnitude is at or below threshold
+static inline axes_t axes_deadband(axes_t value, int16_t threshold) {
+  axes_t result;
+  for (int i = 0; i < AXES_LANES; i++) {
+    int16_t v = value.lane[i];
+    result.lane[i] = (v > threshold || v < -threshold) ? v : 0;
+  }
+  return result;
+}
+
+// Dot product over all axes, e.g. axes_dot(v, v) for the squared magnitude
+//  lanes must stay within +/-26754 for the sum to fit in 32 bits
+static inline int32_t axes_dot(axes_t a, axes_t b) {
+#if AXES_SIMD
+  return (int32_t)__SMLAD(a.pair[1], b.pair[1], __SMLAD(a.pair[0], b.pair[0], 0));
+#else
+  int32_t sum = 0;
+  for (int i = 0; i < AXES_LANES; i++) {
+    sum += (int32_t)a.lane[i] * b.lane[i];
+  }
+  return sum;
+#endif
+}
+
+// Per-axis sum + value, widening value to the accumulator lanes
+//  holds at least 65536 full-scale samples before it can overflow
+static inline axes_sum_t axes_accumulate(axes_sum_t sum, axes_t value) {
+  for (int i = 0; i < AXES_LANES; i++) {
+    sum.lane[i] += value.lane[i];
+  }
+  return sum;
+}
+
+// Return one axis of an accumulator converted back to input units
+static inline float axes_sum_get(axes_sum_t sum, int axis, float scale) {
+  return sum.lane[axis] / scale;
+}
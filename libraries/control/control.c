@@ -0,0 +1,177 @@
+// PID control
+//
+// Per sample, with error e = setpoint - measurement and the measurement change
+// dm filtered to d:
+//  d += alpha*(dm - d)
+//  i += ki*e, clamped to the output range
+//  u = kp*e + i - kd*d + feedforward, clamped to the output range
+// The integral step is dropped when u is saturated on the side it pushes
+// toward, so the integral does not wind up while the actuator is at a limit.
+// The gains are stored per sample, so a call is all the update needs.
+//
+// The Q15 controller keeps the integral and the output sum with 16 fraction
+// bits and the filtered derivative with 8, in 64-bit intermediates, so gains
+// well below one LSB per LSB still integrate and nothing can overflow.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "control.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// fraction bits of the Q15 filtered derivative
+#define DERIVATIVE_BITS 8
+
+// low-pass coefficient for a cutoff at a sample rate
+static float lowpass_alpha(float cutoff_hz, float sample_rate_hz) {
+  if (cutoff_hz <= 0) {
+    return 1.0f;
+  }
+  return 1.0f - expf(-2.0f * (float)M_PI * cutoff_hz / sample_rate_hz);
+}
+
+// convert to Q16.16, saturating
+static int32_t to_q16(float value) {
+  float scaled = value * 65536.0f;
+  if (scaled >= 2147483647.0f) {
+    return INT32_MAX;
+  } else if (scaled <= -2147483648.0f) {
+    return INT32_MIN;
+  }
+  return (int32_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+}
+
+// convert to an int16 limit, saturating
+static int16_t to_q15_limit(float value) {
+  if (value >= INT16_MAX) {
+    return INT16_MAX;
+  } else if (value <= INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)(value + (value >= 0 ? 0.5f : -0.5f));
+}
+
+static float clamp(float value, float min, float max) {
+  if (value > max) {
+    return max;
+  } else if (value < min) {
+    return min;
+  }
+  return value;
+}
+
+static int64_t clamp64(int64_t value, int64_t min, int64_t max) {
+  if (value > max) {
+    return max;
+  } else if (value < min) {
+    return min;
+  }
+  return value;
+}
+
+void pid_init(pid_controller_t* pid, const pid_config_t* config) {
+  pid->output_min = config->output_min;
+  pid->output_max = config->output_max;
+  pid->sample_rate_hz = config->sample_rate_hz;
+  pid->alpha = lowpass_alpha(config->derivative_hz, config->sample_rate_hz);
+  pid_set_gains(pid, config->kp, config->ki, config->kd);
+  pid_reset(pid);
+}
+
+void pid_set_gains(pid_controller_t* pid, float kp, float ki, float kd) {
+  pid->kp = kp;
+  pid->ki = ki / pid->sample_rate_hz;
+  pid->kd = kd * pid->sample_rate_hz;
+}
+
+void pid_reset(pid_controller_t* pid) {
+  pid->integral = 0;
+  pid->derivative = 0;
+  pid->previous = 0;
+  pid->primed = false;
+}
+
+float pid_update(pid_controller_t* pid, float setpoint, float measurement, float feedforward) {
+  float error = setpoint - measurement;
+
+  // no derivative on the first sample
+  if (!pid->primed) {
+    pid->previous = measurement;
+    pid->primed = true;
+  }
+  pid->derivative += pid->alpha * ((measurement - pid->previous) - pid->derivative);
+  pid->previous = measurement;
+
+  float step = pid->ki * error;
+  float integral = clamp(pid->integral + step, pid->output_min, pid->output_max);
+  float fixed = pid->kp * error - pid->kd * pid->derivative + feedforward;
+  float output = fixed + integral;
+
+  // anti-windup: hold the integral while it would push further into a limit
+  if ((output > pid->output_max && step > 0) || (output < pid->output_min && step < 0)) {
+    output = fixed + pid->integral;
+  } else {
+    pid->integral = integral;
+  }
+  return clamp(output, pid->output_min, pid->output_max);
+}
+
+void pid_q15_init(pid_q15_controller_t* pid, const pid_config_t* config) {
+  pid->output_min = to_q15_limit(config->output_min);
+  pid->output_max = to_q15_limit(config->output_max);
+  pid->sample_rate_hz = config->sample_rate_hz;
+  pid->alpha = to_q16(lowpass_alpha(config->derivative_hz, config->sample_rate_hz));
+  pid_q15_set_gains(pid, config->kp, config->ki, config->kd);
+  pid_q15_reset(pid);
+}
+
+void pid_q15_set_gains(pid_q15_controller_t* pid, float kp, float ki, float kd) {
+  pid->kp = to_q16(kp);
+  pid->ki = to_q16(ki / pid->sample_rate_hz);
+  pid->kd = to_q16(kd * pid->sample_rate_hz);
+}
+
+void pid_q15_reset(pid_q15_controller_t* pid) {
+  pid->integral = 0;
+  pid->derivative = 0;
+  pid->previous = 0;
+  pid->primed = false;
+}
+
+int16_t pid_q15_update(pid_q15_controller_t* pid, int16_t setpoint, int16_t measurement, int16_t feedforward) {
+  int32_t error = (int32_t)setpoint - measurement;
+
+  // no derivative on the first sample
+  if (!pid->primed) {
+    pid->previous = measurement;
+    pid->primed = true;
+  }
+  int32_t change = ((int32_t)measurement - pid->previous) * (1 << DERIVATIVE_BITS);
+  pid->derivative += (int32_t)(((int64_t)pid->alpha * (change - pid->derivative)) >> 16);
+  pid->previous = measurement;
+
+  // everything below is in output LSBs with 16 fraction bits
+  int64_t min = (int64_t)pid->output_min << 16;
+  int64_t max = (int64_t)pid->output_max << 16;
+  int64_t step = (int64_t)pid->ki * error;
+  int64_t integral = clamp64(pid->integral + step, min, max);
+  int64_t fixed = (int64_t)pid->kp * error
+      - (((int64_t)pid->kd * pid->derivative) >> DERIVATIVE_BITS)
+      + ((int64_t)feedforward << 16);
+  int64_t output = fixed + integral;
+
+  // anti-windup: hold the integral while it would push further into a limit
+  if ((output > max && step > 0) || (output < min && step < 0)) {
+    output = fixed + pid->integral;
+  } else {
+    pid->integral = (int32_t)integral;
+  }
+
+  // round to the nearest LSB
+  output = (output + (1 << 15)) >> 16;
+  return (int16_t)clamp64(output, pid->output_min, pid->output_max);
+}
@@ -0,0 +1,109 @@
+// PID control
+//
+// Fixed-rate PID controllers for the stabilization loop, one in float and one
+// in Q15 fixed point with the same behavior. Both take a feed-forward term
+// added ahead of the output clamp, filter the derivative with a first order
+// low-pass, take the derivative of the measurement rather than the error so
+// setpoint steps do not kick the output, and stop integrating while the
+// output is saturated in the direction the integral would push it. State is
+// owned by the caller and every update runs the same instructions.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Types
+
+// Controller configuration. The Q15 controller reads the same fields, with
+// signals, limits, and gains all in LSBs: a gain of 1.0 moves the output one
+// LSB per LSB of error.
+typedef struct {
+  float kp;             // output per unit error
+  float ki;             // output per unit error per second
+  float kd;             // output per unit measurement change per second
+  float derivative_hz;  // derivative low-pass cutoff, 0 for no filtering
+  float output_min;     // output clamp, also bounds the integral
+  float output_max;
+  float sample_rate_hz; // rate the update is called at
+} pid_config_t;
+
+typedef struct {
+  float kp;
+  float ki;         // per sample
+  float kd;         // per sample of measurement change
+  float alpha;      // derivative low-pass coefficient
+  float integral;   // integral term, in output units
+  float derivative; // filtered measurement change per sample
+  float previous;   // last measurement
+  bool primed;      // previous is valid
+  float output_min;
+  float output_max;
+  float sample_rate_hz;
+} pid_controller_t;
+
+typedef struct {
+  int32_t kp;         // Q16.16
+  int32_t ki;         // Q16.16, per sample
+  int32_t kd;         // Q16.16, per sample of measurement change
+  int32_t alpha;      // Q16 derivative low-pass coefficient
+  int32_t integral;   // integral term, output LSBs in Q15.16
+  int32_t derivative; // filtered measurement change per sample, Q.8
+  int16_t previous;   // last measurement
+  bool primed;        // previous is valid
+  int16_t output_min;
+  int16_t output_max;
+  float sample_rate_hz;
+} pid_q15_controller_t;
+
+// Default configuration: proportional only, output -1 to 1, 50 Hz
+#define PID_DEFAULT_CONFIG { \
+  .kp = 1.0,                 \
+  .ki = 0.0,                 \
+  .kd = 0.0,                 \
+  .derivative_hz = 10.0,     \
+  .output_min = -1.0,        \
+  .output_max = 1.0,         \
+  .sample_rate_hz = 50.0,    \
+}
+
+
+// Function prototypes
+
+// Initialize a float controller, with no integral or derivative history
+//
+// pid - state to initialize, owned by the caller
+// config - gains, derivative filter, output limits, and update rate
+void pid_init(pid_controller_t* pid, const pid_config_t* config);
+
+// Change the gains, keeping the integral and derivative history
+void pid_set_gains(pid_controller_t* pid, float kp, float ki, float kd);
+
+// Clear the integral and derivative history
+void pid_reset(pid_controller_t* pid);
+
+// Run one control step
+//
+// setpoint - value the measurement should reach
+// measurement - latest measurement
+// feedforward - output known to be needed, added before the clamp
+//
+// Return the clamped output
+float pid_update(pid_controller_t* pid, float setpoint, float measurement, float feedforward);
+
+// Initialize a Q15 controller, with no integral or derivative history
+//
+// pid - state to initialize, owned by the caller
+// config - gains, derivative filter, output limits, and update rate in LSBs
+void pid_q15_init(pid_q15_controller_t* pid, const pid_config_t* config);
+
+// Change the gains, keeping the integral and derivative history
+void pid_q15_set_gains(pid_q15_controller_t* pid, float kp, float ki, float kd);
+
+// Clear the integral and derivative history
+void pid_q15_reset(pid_q15_controller_t* pid);
+
+// Run one control step, in integer arithmetic only
+//
+// Return the clamped output
+int16_t pid_q15_update(pid_q15_controller_t* pid, int16_t setpoint, int16_t measurement, int16_t feedforward);
@@ -0,0 +1,213 @@
+// Tremor Kalman filter
+//
+// The drift is a constant-velocity model driven by white acceleration. The
+// tremor is a rotation of (angle, rate / omega) by omega * dt per sample, with
+// white noise on both components letting its amplitude and phase wander.
+// The 2x2 innovation covariance is inverted in closed form.
+
+#include <math.h>
+#include <string.h>
+
+#include "kalman.h"
+
+#define N KALMAN_STATES
+#define M KALMAN_MEASUREMENTS
+
+// state indices
+enum {
+  DRIFT_ANGLE = 0,
+  DRIFT_RATE,
+  TREMOR_ANGLE,
+  TREMOR_QUADRATURE,
+};
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// transition matrix for a step of dt seconds
+static void transition(const kalman_t* filter, float dt, float F[N][N]) {
+  memset(F, 0, sizeof(float) * N * N);
+  F[DRIFT_ANGLE][DRIFT_ANGLE] = 1;
+  F[DRIFT_ANGLE][DRIFT_RATE] = dt;
+  F[DRIFT_RATE][DRIFT_RATE] = 1;
+
+  float c = cosf(filter->omega * dt);
+  float s = sinf(filter->omega * dt);
+  F[TREMOR_ANGLE][TREMOR_ANGLE] = c;
+  F[TREMOR_ANGLE][TREMOR_QUADRATURE] = s;
+  F[TREMOR_QUADRATURE][TREMOR_ANGLE] = -s;
+  F[TREMOR_QUADRATURE][TREMOR_QUADRATURE] = c;
+}
+
+void kalman_init(kalman_t* filter, const kalman_config_t* config) {
+  memset(filter, 0, sizeof(kalman_t));
+  filter->dt = 1.0f / config->sample_rate_hz;
+  kalman_set_frequency(filter, config->tremor_hz);
+
+  float dt = filter->dt;
+  float q_drift = config->drift_noise * config->drift_noise;
+  filter->Q[DRIFT_ANGLE][DRIFT_ANGLE] = q_drift * dt * dt * dt / 3.0f;
+  filter->Q[DRIFT_ANGLE][DRIFT_RATE] = q_drift * dt * dt / 2.0f;
+  filter->Q[DRIFT_RATE][DRIFT_ANGLE] = q_drift * dt * dt / 2.0f;
+  filter->Q[DRIFT_RATE][DRIFT_RATE] = q_drift * dt;
+  float q_tremor = config->tremor_noise * config->tremor_noise;
+  filter->Q[TREMOR_ANGLE][TREMOR_ANGLE] = q_tremor * dt;
+  filter->Q[TREMOR_QUADRATURE][TREMOR_QUADRATURE] = q_tremor * dt;
+
+  filter->R[0] = config->angle_noise * config->angle_noise;
+  filter->R[1] = config->rate_noise * config->rate_noise;
+
+  // start uncertain so the first measurements dominate
+  for (int i = 0; i < N; i++) {
+    filter->P[i][i] = 1000.0f;
+  }
+}
+
+void kalman_set_frequency(kalman_t* filter, float hz) {
+  float omega = 2.0f * (float)M_PI * hz;
+
+  // the quadrature state is the tremor rate / omega, so keep the rate it
+  // stands for by scaling it, and its covariance row and column, by
+  // old / new omega
+  if (filter->omega > 0 && omega > 0 && omega != filter->omega) {
+    float ratio = filter->omega / omega;
+    filter->x[TREMOR_QUADRATURE] *= ratio;
+    for (int i = 0; i < N; i++) {
+      filter->P[TREMOR_QUADRATURE][i] *= ratio;
+      filter->P[i][TREMOR_QUADRATURE] *= ratio;
+    }
+  }
+  filter->omega = omega;
+}
+
+void kalman_update(kalman_t* filter, float angle, float rate) {
+  float F[N][N];
+  transition(filter, filter->dt, F);
+
+  // predict: x = F x, P = F P F' + Q
+  float x[N];
+  for (int i = 0; i < N; i++) {
+    x[i] = 0;
+    for (int j = 0; j < N; j++) {
+      x[i] += F[i][j] * filter->x[j];
+    }
+  }
+  float FP[N][N];
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      FP[i][j] = 0;
+      for (int k = 0; k < N; k++) {
+        FP[i][j] += F[i][k] * filter->P[k][j];
+      }
+    }
+  }
+  float P[N][N];
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      P[i][j] = filter->Q[i][j];
+      for (int k = 0; k < N; k++) {
+        P[i][j] += FP[i][k] * F[j][k];
+      }
+    }
+  }
+
+  // measurement rows H: angle = [1 0 1 0], rate = [0 1 0 omega]
+  float H[M][N] = {
+    {1, 0, 1, 0},
+    {0, 1, 0, filter->omega},
+  };
+
+  // HP = H P, S = H P H' + R
+  float HP[M][N];
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      HP[i][j] = 0;
+      for (int k = 0; k < N; k++) {
+        HP[i][j] += H[i][k] * P[k][j];
+      }
+    }
+  }
+  float S[M][M];
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < M; j++) {
+      S[i][j] = (i == j) ? filter->R[i] : 0;
+      for (int k = 0; k < N; k++) {
+        S[i][j] += HP[i][k] * H[j][k];
+      }
+    }
+  }
+  float det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+  if (det <= 0) {
+    // numerically broken, keep the prediction
+    memcpy(filter->x, x, sizeof(x));
+    memcpy(filter->P, P, sizeof(P));
+    return;
+  }
+  float S_inv[M][M] = {
+    { S[1][1] / det, -S[0][1] / det},
+    {-S[1][0] / det,  S[0][0] / det},
+  };
+
+  // K = P H' S^-1 = (H P)' S^-1 since P is symmetric
+  float K[N][M];
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < M; j++) {
+      K[i][j] = 0;
+      for (int k = 0; k < M; k++) {
+        K[i][j] += HP[k][i] * S_inv[k][j];
+      }
+    }
+  }
+
+  // correct: x += K (z - H x), P -= K H P
+  float innovation[M] = {
+    angle - (x[DRIFT_ANGLE] + x[TREMOR_ANGLE]),
+    rate - (x[DRIFT_RATE] + filter->omega * x[TREMOR_QUADRATURE]),
+  };
+  for (int i = 0; i < N; i++) {
+    filter->x[i] = x[i];
+    for (int j = 0; j < M; j++) {
+      filter->x[i] += K[i][j] * innovation[j];
+    }
+  }
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      float KHP = 0;
+      for (int k = 0; k < M; k++) {
+        KHP += K[i][k] * HP[k][j];
+      }
+      filter->P[i][j] = P[i][j] - KHP;
+    }
+  }
+
+  // keep P symmetric against rounding
+  for (int i = 0; i < N; i++) {
+    for (int j = i + 1; j < N; j++) {
+      float average = 0.5f * (filter->P[i][j] + filter->P[j][i]);
+      filter->P[i][j] = average;
+      filter->P[j][i] = average;
+    }
+  }
+}
+
+kalman_prediction_t kalman_predict(const kalman_t* filter, float horizon_s) {
+  float F[N][N];
+  transition(filter, horizon_s, F);
+
+  float x[N];
+  for (int i = 0; i < N; i++) {
+    x[i] = 0;
+    for (int j = 0; j < N; j++) {
+      x[i] += F[i][j] * filter->x[j];
+    }
+  }
+
+  kalman_prediction_t prediction = {
+    .tremor_angle = x[TREMOR_ANGLE],
+    .tremor_rate = filter->omega * x[TREMOR_QUADRATURE],
+  };
+  prediction.angle = x[DRIFT_ANGLE] + prediction.tremor_angle;
+  prediction.rate = x[DRIFT_RATE] + prediction.tremor_rate;
+  return prediction;
+}
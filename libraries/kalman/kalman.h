@@ -0,0 +1,77 @@
+// Tremor Kalman filter
+//
+// Linear Kalman filter on a constant-frequency oscillator (the tremor) plus
+// a drift (voluntary motion), fusing an angle and an angular rate
+// measurement. Sizes are fixed at compile time, so there is no allocation and
+// every update costs the same.
+//
+// State: drift angle, drift rate, tremor angle, tremor rate / omega
+// Measurements: angle = drift angle + tremor angle
+//               rate = drift rate + omega * (tremor rate / omega)
+
+#pragma once
+
+// Configuration
+
+#define KALMAN_STATES 4
+#define KALMAN_MEASUREMENTS 2
+
+// Types
+
+typedef struct {
+  float sample_rate_hz;  // rate kalman_update is called at
+  float tremor_hz;       // initial oscillator frequency
+  float drift_noise;     // drift acceleration noise density, units/s^2/sqrt(Hz)
+  float tremor_noise;    // tremor amplitude noise density, units/sqrt(Hz)
+  float angle_noise;     // angle measurement standard deviation, units
+  float rate_noise;      // rate measurement standard deviation, units/s
+} kalman_config_t;
+
+typedef struct {
+  float x[KALMAN_STATES];
+  float P[KALMAN_STATES][KALMAN_STATES];
+  float Q[KALMAN_STATES][KALMAN_STATES];
+  float R[KALMAN_MEASUREMENTS];
+  float dt;
+  float omega;  // oscillator frequency, radians/second
+} kalman_t;
+
+typedef struct {
+  float angle;         // total angle
+  float rate;          // total rate
+  float tremor_angle;  // oscillator component only
+  float tremor_rate;
+} kalman_prediction_t;
+
+// Default configuration for a 50 Hz stream in degrees and degrees/second
+//  the angle is integrated from the gyro with a deadband, so it is trusted
+//  far less than the rate
+#define KALMAN_DEFAULT_CONFIG { \
+  .sample_rate_hz = 50.0,       \
+  .tremor_hz = 6.0,             \
+  .drift_noise = 1000.0,        \
+  .tremor_noise = 1.0,          \
+  .angle_noise = 20.0,          \
+  .rate_noise = 3.0,            \
+}
+
+
+// Function prototypes
+
+// Initialize a filter
+//
+// filter - state to initialize, owned by the caller
+// config - sample rate, initial frequency, and noise levels
+void kalman_init(kalman_t* filter, const kalman_config_t* config);
+
+// Change the oscillator frequency, e.g. from a frequency tracker
+//  the tremor angle and rate estimates carry over unchanged
+void kalman_set_frequency(kalman_t* filter, float hz);
+
+// Advance one sample and fuse the angle and rate measured at it
+void kalman_update(kalman_t* filter, float angle, float rate);
+
+// Predict angle and rate ahead of the last update
+//
+// horizon_s - time after the last update, e.g. the actuator latency
+kalman_prediction_t kalman_predict(const kalman_t* filter, float horizon_s);
@@ -0,0 +1,177 @@
+// Sensor-to-actuation latency instrumentation
+//
+// The marks of the step in progress are kept until the next step starts. A
+// commit queues the read start and commit times with the number of its
+// update. A profiled servo plays an update up to two frames after it is
+// written, so the next steps may commit before then. The frame interrupt
+// then takes the newest queued update its frame plays and measures against
+// the step that produced it. Older updates it passes over were replaced
+// before any frame played them, and are counted as superseded.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "latency.h"
+#include "virtual_timer.h"
+
+#if LATENCY_ENABLED
+
+#ifdef VIRTUAL_TIMER_HAL_SIM
+// single threaded on the host
+#define LATENCY_CRITICAL_ENTER()
+#define LATENCY_CRITICAL_EXIT()
+#else
+#include "app_util_platform.h"
+#include "nrf_gpio.h"
+#define LATENCY_CRITICAL_ENTER() CRITICAL_REGION_ENTER()
+#define LATENCY_CRITICAL_EXIT() CRITICAL_REGION_EXIT()
+#endif
+
+#if defined(LATENCY_MARKER_PIN) && !defined(VIRTUAL_TIMER_HAL_SIM)
+#define MARKER_SET() nrf_gpio_pin_set(LATENCY_MARKER_PIN)
+#define MARKER_CLEAR() nrf_gpio_pin_clear(LATENCY_MARKER_PIN)
+#else
+#define MARKER_SET()
+#define MARKER_CLEAR()
+#endif
+
+// bucket widths sized to the expected range of each stage: an I2C read of a
+// few milliseconds, sub-millisecond computation, a few microseconds to
+// write the PWM buffer, and up to two 20 ms frames of waiting
+static const uint32_t BUCKET_US[LATENCY_STAGES] = {100, 25, 5, 2000, 2000};
+
+// committed updates a frame may not have played yet
+#define IN_FLIGHT 4
+
+static const char* const STAGE_NAMES[LATENCY_STAGES] = {
+  "IMU read",
+  "Compute",
+  "Commit",
+  "Frame wait",
+  "Sensor to actuation",
+};
+
+static timer_histogram_t histograms[LATENCY_STAGES];
+
+// marks of the step in progress
+static uint32_t read_start;
+static uint32_t read_end;
+static uint32_t computed;
+
+// committed updates waiting for a frame to apply them, oldest first
+typedef struct {
+  uint32_t update;
+  uint32_t start;
+  uint32_t commit;
+} committed_t;
+
+static committed_t queue[IN_FLIGHT];
+static volatile uint32_t queue_first = 0;
+static volatile uint32_t queue_count = 0;
+static volatile uint32_t superseded = 0;
+
+void latency_init(void) {
+#if defined(LATENCY_MARKER_PIN) && !defined(VIRTUAL_TIMER_HAL_SIM)
+  nrf_gpio_cfg_output(LATENCY_MARKER_PIN);
+  nrf_gpio_pin_clear(LATENCY_MARKER_PIN);
+#endif
+  latency_reset();
+}
+
+void latency_mark(latency_mark_t mark) {
+  uint32_t now = read_timer();
+
+  switch (mark) {
+    case LATENCY_READ_START:
+      MARKER_SET();
+      read_start = now;
+      break;
+
+    case LATENCY_READ_END:
+      MARKER_CLEAR();
+      read_end = now;
+      timer_histogram_add(&histograms[LATENCY_STAGE_READ], now - read_start);
+      break;
+
+    case LATENCY_COMPUTED:
+      MARKER_SET();
+      computed = now;
+      timer_histogram_add(&histograms[LATENCY_STAGE_COMPUTE], now - read_end);
+      break;
+  }
+}
+
+void latency_commit(uint32_t update) {
+  uint32_t now = read_timer();
+  MARKER_CLEAR();
+  timer_histogram_add(&histograms[LATENCY_STAGE_COMMIT], now - computed);
+
+  LATENCY_CRITICAL_ENTER();
+  if (queue_count == IN_FLIGHT) {
+    // no frame has played the oldest, and it is too late to tell
+    queue_first = (queue_first + 1) % IN_FLIGHT;
+    queue_count--;
+    superseded++;
+  }
+  committed_t* entry = &queue[(queue_first + queue_count) % IN_FLIGHT];
+  entry->update = update;
+  entry->start = read_start;
+  entry->commit = now;
+  queue_count++;
+  LATENCY_CRITICAL_EXIT();
+}
+
+void latency_apply(uint32_t update) {
+  uint32_t now = read_timer();
+
+  // the newest committed update at or before the one the frame plays
+  committed_t applied;
+  bool found = false;
+  while (queue_count > 0 && (int32_t)(queue[queue_first].update - update) <= 0) {
+    if (found) {
+      superseded++;
+    }
+    applied = queue[queue_first];
+    found = true;
+    queue_first = (queue_first + 1) % IN_FLIGHT;
+    queue_count--;
+  }
+
+  if (found) {
+    MARKER_SET();
+    timer_histogram_add(&histograms[LATENCY_STAGE_FRAME], now - applied.commit);
+    timer_histogram_add(&histograms[LATENCY_STAGE_TOTAL], now - applied.start);
+    MARKER_CLEAR();
+  }
+}
+
+void latency_get(latency_stage_t stage, timer_histogram_t* histogram) {
+  LATENCY_CRITICAL_ENTER();
+  *histogram = histograms[stage];
+  LATENCY_CRITICAL_EXIT();
+}
+
+void latency_reset(void) {
+  LATENCY_CRITICAL_ENTER();
+  for (int i = 0; i < LATENCY_STAGES; i++) {
+    timer_histogram_reset(&histograms[i], BUCKET_US[i]);
+  }
+  queue_first = 0;
+  queue_count = 0;
+  superseded = 0;
+  LATENCY_CRITICAL_EXIT();
+}
+
+void latency_print(void) {
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    // copy out so printing does not hold off the PWM interrupt
+    timer_histogram_t histogram;
+    latency_get(stage, &histogram);
+    timer_histogram_print(STAGE_NAMES[stage], &histogram);
+  }
+  printf("Superseded updates: %" PRIu32 "\n", superseded);
+}
+
+#endif
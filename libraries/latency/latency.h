@@ -0,0 +1,94 @@
+// Sensor-to-actuation latency instrumentation
+//
+// Timestamps each control step as it passes through the IMU read, the
+// algorithm, and the servo update, and the PWM frame that finally applies
+// the update, then keeps a histogram of every stage and of the total. Times
+// come from the free-running virtual timer counter (TIMER4 at 1 MHz), so the
+// same code runs on a host against the simulated virtual timer backend.
+//
+// Enable by defining LATENCY_ENABLED to 1 (for example with
+// -DLATENCY_ENABLED=1 in the app Makefile). When disabled, LATENCY_MARK
+// compiles to nothing and the library contains no code.
+//
+// Defining LATENCY_MARKER_PIN drives that pin for a logic analyzer: high
+// during the IMU read, high again from the end of the algorithm to the servo
+// update, and a short pulse when the update is applied. Probing the servo
+// output as well shows the pulse width change itself.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "virtual_timer_stats.h"
+
+// Configuration
+
+#ifndef LATENCY_ENABLED
+#define LATENCY_ENABLED 0
+#endif
+
+// Types
+
+// points in a control step, marked in this order, followed by the commit
+// and apply of its update
+typedef enum {
+  LATENCY_READ_START, // IMU read begins
+  LATENCY_READ_END,   // IMU sample is available
+  LATENCY_COMPUTED,   // servo commands are known
+} latency_mark_t;
+
+// intervals between marks
+typedef enum {
+  LATENCY_STAGE_READ,    // read start to read end
+  LATENCY_STAGE_COMPUTE, // read end to computed
+  LATENCY_STAGE_COMMIT,  // computed to committed
+  LATENCY_STAGE_FRAME,   // committed to applied
+  LATENCY_STAGE_TOTAL,   // read start to applied
+  LATENCY_STAGES,
+} latency_stage_t;
+
+#if LATENCY_ENABLED
+#define LATENCY_MARK(mark) latency_mark(mark)
+#define LATENCY_COMMIT(update) latency_commit(update)
+#define LATENCY_APPLY(update) latency_apply(update)
+#else
+#define LATENCY_MARK(mark) do {} while (0)
+#define LATENCY_COMMIT(update) do {} while (0)
+#define LATENCY_APPLY(update) do {} while (0)
+#endif
+
+
+// Function prototypes
+
+#if LATENCY_ENABLED
+// Clear every histogram and configure the marker pin
+// Call after virtual_timer_init()
+void latency_init(void);
+
+// Record a point in the current control step
+void latency_mark(latency_mark_t mark);
+
+// Record that the servo commands of the current step are written
+//
+// update - number the output identifies the update by, counting up, such as
+//  servo_update_count() after the writes
+void latency_commit(uint32_t update);
+
+// Record that the PWM frame starting now plays every update up to update
+//
+// Call from the frame interrupt. Frames that play no newly committed update
+// are ignored, and committed updates that are passed over are counted as
+// superseded
+void latency_apply(uint32_t update);
+
+// Copy the histogram of one stage, in microseconds
+//  Read it with timer_histogram_percentile() and timer_histogram_print()
+void latency_get(latency_stage_t stage, timer_histogram_t* histogram);
+
+// Clear every histogram
+void latency_reset(void);
+
+// Print every stage histogram over RTT
+void latency_print(void);
+#endif
@@ -0,0 +1,70 @@
+// Motion profile
+//
+// Each step picks the velocity the output should have now: the velocity
+// limit, or the fastest speed from which it can still brake onto the target,
+// whichever is lower. The current velocity moves toward that by at most one
+// acceleration step, then the position integrates the new velocity.
+//
+// Braking from velocity v in steps of dv, with the position updated after
+// each step, covers dt*(v + (v - dv) + ... + dv) = dt*v*(v/dv + 1)/2. Solving
+// for the distance d left to the target gives the braking velocity
+//  v = (sqrt(dv^2 + 8*dv*d/dt) - dv) / 2
+// which lands exactly on the target instead of overshooting by the last step.
+// When the velocity is not a whole number of steps the last step can pass the
+// target by a fraction of a step, so any step that reaches the target at no
+// more than one acceleration step of speed stops on it instead.
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "motion.h"
+
+void motion_init(motion_profile_t* profile, const motion_config_t* config, float period_s, float position) {
+  profile->max_velocity = config->max_velocity;
+  profile->velocity_step = config->max_acceleration * period_s;
+  profile->period_s = period_s;
+  motion_reset(profile, position);
+}
+
+void motion_reset(motion_profile_t* profile, float position) {
+  profile->position = position;
+  profile->velocity = 0;
+}
+
+float motion_update(motion_profile_t* profile, float target) {
+  float error = target - profile->position;
+  float distance = fabsf(error);
+  float dv = profile->velocity_step;
+  float dt = profile->period_s;
+
+  float desired = 0.5f * (sqrtf(dv * dv + 8.0f * dv * distance / dt) - dv);
+  if (desired > profile->max_velocity) {
+    desired = profile->max_velocity;
+  }
+  if (error < 0) {
+    desired = -desired;
+  }
+
+  float change = desired - profile->velocity;
+  if (change > dv) {
+    change = dv;
+  } else if (change < -dv) {
+    change = -dv;
+  }
+  float velocity = profile->velocity + change;
+
+  // reaching the target this step, slow enough to stop on it
+  if (velocity * error >= 0 && distance <= fabsf(velocity) * dt && fabsf(velocity) <= dv) {
+    profile->position = target;
+    profile->velocity = 0;
+    return profile->position;
+  }
+
+  profile->velocity = velocity;
+  profile->position += velocity * dt;
+  return profile->position;
+}
+
+bool motion_settled(const motion_profile_t* profile, float target) {
+  return profile->position == target && profile->velocity == 0;
+}
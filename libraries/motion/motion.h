@@ -0,0 +1,50 @@
+// Motion profile
+//
+// Velocity and acceleration limited trajectory toward a moving target, for
+// smoothing actuator commands. Stepping at a fixed rate produces a
+// trapezoidal velocity profile for a step in the target, or a triangular one
+// when the step is too short to reach full velocity, and the output stops on
+// the target without passing it. That bounds the command only: an actuator
+// following it still overshoots through its own dynamics, just less than on
+// a step. Each step is constant time.
+
+#pragma once
+
+#include <stdbool.h>
+
+// Types
+
+typedef struct {
+  float max_velocity;     // output units per second
+  float max_acceleration; // output units per second squared
+} motion_config_t;
+
+typedef struct {
+  float position;       // current output
+  float velocity;       // output units per second
+  float max_velocity;
+  float velocity_step;  // largest velocity change in one step
+  float period_s;
+} motion_profile_t;
+
+
+// Function prototypes
+
+// Initialize a profile at rest
+//
+// profile - state to initialize, owned by the caller
+// config - velocity and acceleration limits
+// period_s - time between calls to motion_update
+// position - starting output
+void motion_init(motion_profile_t* profile, const motion_config_t* config, float period_s, float position);
+
+// Move the output to a position and stop it there, with no limiting
+void motion_reset(motion_profile_t* profile, float position);
+
+// Advance the output one step toward the target
+//
+// Return the new output
+float motion_update(motion_profile_t* profile, float target);
+
+// Return true if the output is at rest on the target
+bool motion_settled(const motion_profile_t* profile, float target);
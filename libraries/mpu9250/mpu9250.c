@@ -9,14 +9,19 @@
 #include <stdint.h>
 
 #include "app_error.h"
+#include "app_util_platform.h"
 #include "nrf.h"
 #include "nrf_delay.h"
+#include "nrf_drv_gpiote.h"
 #include "nrf_drv_timer.h"
 #include "nrf_twi_mngr.h"
 
+#include "latency.h"
 #include "mpu9250.h"
 
-static uint8_t MPU_ADDRESS = 0x69;
+#define MPU_I2C_ADDR 0x69
+
+static uint8_t MPU_ADDRESS = MPU_I2C_ADDR;
 static uint8_t MAG_ADDRESS = 0x0C;
 
 static const nrf_twi_mngr_t* i2c_manager = NULL;
@@ -26,6 +31,54 @@ static const nrf_drv_timer_t gyro_timer = NRFX_TIMER_INSTANCE(1);
 static mpu9250_measurement_t integrated_angle;
 static uint32_t prev_timer_val;
 
+// fifo batching variables
+static bool fifo_running = false;
+static uint32_t fifo_period_us = 0;
+static uint32_t fifo_frame_count = 0;
+static uint8_t fifo_buf[MPU9250_FIFO_MAX_DRAIN * MPU9250_FIFO_FRAME_BYTES];
+
+// async read variables
+// two buffers so the callback can unpack sample k while sample k+1 transfers
+static uint8_t async_reg_addr[1] = {MPU9250_ACCEL_XOUT_H};
+static uint8_t async_buf[2][MPU9250_SAMPLE_BYTES] = {{0}};
+static volatile uint8_t async_next_buf = 0;
+static volatile uint8_t async_in_flight = 0;
+static mpu9250_read_callback* async_callback = NULL;
+
+static void async_read_callback(ret_code_t result, void* p_context);
+
+static nrf_twi_mngr_transfer_t const async_transfer_ping[] = {
+  NRF_TWI_MNGR_WRITE(MPU_I2C_ADDR, async_reg_addr, 1, NRF_TWI_MNGR_NO_STOP),
+  NRF_TWI_MNGR_READ(MPU_I2C_ADDR, async_buf[0], MPU9250_SAMPLE_BYTES, 0),
+};
+
+static nrf_twi_mngr_transfer_t const async_transfer_pong[] = {
+  NRF_TWI_MNGR_WRITE(MPU_I2C_ADDR, async_reg_addr, 1, NRF_TWI_MNGR_NO_STOP),
+  NRF_TWI_MNGR_READ(MPU_I2C_ADDR, async_buf[1], MPU9250_SAMPLE_BYTES, 0),
+};
+
+static nrf_twi_mngr_transaction_t const async_transaction[2] = {
+  {
+    .callback = async_read_callback,
+    .p_user_data = (void*)0,
+    .p_transfers = async_transfer_ping,
+    .number_of_transfers = sizeof(async_transfer_ping)/sizeof(async_transfer_ping[0]),
+    .p_required_twi_cfg = NULL
+  },
+  {
+    .callback = async_read_callback,
+    .p_user_data = (void*)1,
+    .p_transfers = async_transfer_pong,
+    .number_of_transfers = sizeof(async_transfer_pong)/sizeof(async_transfer_pong[0]),
+    .p_required_twi_cfg = NULL
+  },
+};
+
+// data-ready interrupt variables
+static nrfx_gpiote_pin_t data_ready_pin = 0;
+static bool data_ready_running = false;
+static volatile uint32_t data_ready_missed = 0;
+
 static void gyro_timer_event_handler(nrf_timer_event_t event_type, void* p_context) {
   // don't care about events
 }
@@ -41,6 +94,15 @@ static uint8_t i2c_reg_read(uint8_t i2c_addr, uint8_t reg_addr) {
   return rx_buf;
 }
 
+static void i2c_burst_read(uint8_t i2c_addr, uint8_t reg_addr, uint8_t* rx_buf, uint8_t len) {
+  nrf_twi_mngr_transfer_t const read_transfer[] = {
+    NRF_TWI_MNGR_WRITE(i2c_addr, &reg_addr, 1, NRF_TWI_MNGR_NO_STOP),
+    NRF_TWI_MNGR_READ(i2c_addr, rx_buf, len, 0),
+  };
+  ret_code_t error_code = nrf_twi_mngr_perform(i2c_manager, NULL, read_transfer, 2, NULL);
+  APP_ERROR_CHECK(error_code);
+}
+
 static void i2c_reg_write(uint8_t i2c_addr, uint8_t reg_addr, uint8_t data) {
   uint8_t buf[2] = {reg_addr, data};
   nrf_twi_mngr_transfer_t const write_transfer[] = {
@@ -50,6 +112,16 @@ static void i2c_reg_write(uint8_t i2c_addr, uint8_t reg_addr, uint8_t data) {
   APP_ERROR_CHECK(error_code);
 }
 
+// set DLPFs to 184 Hz and the internal sample rate to 1 kHz / (1 + divider)
+// fifo_mode - stop writing to the fifo when it is full
+static uint32_t configure_sample_rate(uint16_t sample_rate_hz, bool fifo_mode) {
+  uint8_t divider = (1000 / sample_rate_hz) - 1;
+  i2c_reg_write(MPU_ADDRESS, MPU9250_CONFIG, 0x01 | (fifo_mode ? 0x40 : 0x00));
+  i2c_reg_write(MPU_ADDRESS, MPU9250_ACCEL_CONFIG_2, 0x01);
+  i2c_reg_write(MPU_ADDRESS, MPU9250_SMPLRT_DIV, divider);
+  return 1000 * ((uint32_t)divider + 1);
+}
+
 // initialization and configuration
 void mpu9250_init(const nrf_twi_mngr_t* i2c) {
 
@@ -93,14 +165,13 @@ void mpu9250_init(const nrf_twi_mngr_t* i2c) {
   i2c_reg_write(MAG_ADDRESS, AK8963_CNTL1, 0x02);
 }
 
-mpu9250_measurement_t mpu9250_read_accelerometer() {
-  // read values
-  int16_t x_val = (((uint16_t)i2c_reg_read(MPU_ADDRESS, MPU9250_ACCEL_XOUT_H)) << 8) | i2c_reg_read(MPU_ADDRESS, MPU9250_ACCEL_XOUT_L);
-  int16_t y_val = (((uint16_t)i2c_reg_read(MPU_ADDRESS, MPU9250_ACCEL_YOUT_H)) << 8) | i2c_reg_read(MPU_ADDRESS, MPU9250_ACCEL_YOUT_L);
-  int16_t z_val = (((uint16_t)i2c_reg_read(MPU_ADDRESS, MPU9250_ACCEL_ZOUT_H)) << 8) | i2c_reg_read(MPU_ADDRESS, MPU9250_ACCEL_ZOUT_L);
+// convert three big-endian axis registers to g's
+// coversion at +/- 2 g is 16384 LSB/g
+static mpu9250_measurement_t unpack_accel(const uint8_t* buf) {
+  int16_t x_val = (((uint16_t)buf[0]) << 8) | buf[1];
+  int16_t y_val = (((uint16_t)buf[2]) << 8) | buf[3];
+  int16_t z_val = (((uint16_t)buf[4]) << 8) | buf[5];
 
-  // convert to g
-  // coversion at +/- 2 g is 16384 LSB/g
   mpu9250_measurement_t measurement = {0};
   measurement.x_axis = ((float)x_val) / 16384;
   measurement.y_axis = ((float)y_val) / 16384;
@@ -108,14 +179,13 @@ mpu9250_measurement_t mpu9250_read_accelerometer() {
   return measurement;
 }
 
-mpu9250_measurement_t mpu9250_read_gyro() {
-  // read values
-  int16_t x_val = (((uint16_t)i2c_reg_read(MPU_ADDRESS, MPU9250_GYRO_XOUT_H)) << 8) | i2c_reg_read(MPU_ADDRESS, MPU9250_GYRO_XOUT_L);
-  int16_t y_val = (((uint16_t)i2c_reg_read(MPU_ADDRESS, MPU9250_GYRO_YOUT_H)) << 8) | i2c_reg_read(MPU_ADDRESS, MPU9250_GYRO_YOUT_L);
-  int16_t z_val = (((uint16_t)i2c_reg_read(MPU_ADDRESS, MPU9250_GYRO_ZOUT_H)) << 8) | i2c_reg_read(MPU_ADDRESS, MPU9250_GYRO_ZOUT_L);
+// convert three big-endian axis registers to degrees/second
+// coversion at +/- 2000 degrees/second is 16.4 LSB/(degrees/second)
+static mpu9250_measurement_t unpack_gyro(const uint8_t* buf) {
+  int16_t x_val = (((uint16_t)buf[0]) << 8) | buf[1];
+  int16_t y_val = (((uint16_t)buf[2]) << 8) | buf[3];
+  int16_t z_val = (((uint16_t)buf[4]) << 8) | buf[5];
 
-  // convert to g
-  // coversion at +/- 2000 degrees/second is 16.4 LSB/g
   mpu9250_measurement_t measurement = {0};
   measurement.x_axis = ((float)x_val) / 16.4;
   measurement.y_axis = ((float)y_val) / 16.4;
@@ -123,6 +193,36 @@ mpu9250_measurement_t mpu9250_read_gyro() {
   return measurement;
 }
 
+// convert a burst of raw sensor registers into a combined sample
+// buf must hold the 14 bytes from ACCEL_XOUT_H through GYRO_ZOUT_L
+mpu9250_sample_t mpu9250_unpack_sample(const uint8_t* buf) {
+  mpu9250_sample_t sample = {0};
+  sample.accel = unpack_accel(&buf[0]);
+
+  // coversion is 333.87 LSB/degree C with a 21 degree C offset
+  int16_t temp = (((uint16_t)buf[6]) << 8) | buf[7];
+  sample.temperature = ((float)temp) / 333.87 + 21.0;
+
+  sample.gyro = unpack_gyro(&buf[8]);
+  return sample;
+}
+
+mpu9250_sample_t mpu9250_read_all() {
+  // read accel, temp, and gyro registers in a single repeated-start transfer
+  // the registers are contiguous, so the MPU auto-increments the address
+  uint8_t rx_buf[MPU9250_SAMPLE_BYTES] = {0};
+  i2c_burst_read(MPU_ADDRESS, MPU9250_ACCEL_XOUT_H, rx_buf, MPU9250_SAMPLE_BYTES);
+  return mpu9250_unpack_sample(rx_buf);
+}
+
+mpu9250_measurement_t mpu9250_read_accelerometer() {
+  return mpu9250_read_all().accel;
+}
+
+mpu9250_measurement_t mpu9250_read_gyro() {
+  return mpu9250_read_all().gyro;
+}
+
 mpu9250_measurement_t mpu9250_read_magnetometer() {
 
   // read data
@@ -190,3 +290,185 @@ mpu9250_measurement_t mpu9250_read_gyro_integration() {
   return integrated_angle;
 }
 
+
+ret_code_t mpu9250_fifo_start(uint16_t sample_rate_hz) {
+  if (fifo_running) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  // internal sample rate is 1 kHz / (1 + SMPLRT_DIV) with the DLPF enabled
+  if (sample_rate_hz < 4 || sample_rate_hz > 1000) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  // stop and reset the fifo before reconfiguring
+  i2c_reg_write(MPU_ADDRESS, MPU9250_FIFO_EN, 0x00);
+  i2c_reg_write(MPU_ADDRESS, MPU9250_USER_CTRL, 0x04);
+  nrf_delay_ms(1);
+
+  // stop writing when the fifo is full so frames stay aligned and overflow
+  // is reported instead of silently overwritten
+  fifo_period_us = configure_sample_rate(sample_rate_hz, true);
+
+  // enable the fifo, keep the i2c master disabled for bypass mode
+  i2c_reg_write(MPU_ADDRESS, MPU9250_USER_CTRL, 0x40);
+  // push gyro x/y/z and accel into the fifo
+  i2c_reg_write(MPU_ADDRESS, MPU9250_FIFO_EN, 0x78);
+
+  // clear any stale overflow status
+  i2c_reg_read(MPU_ADDRESS, MPU9250_INT_STATUS);
+
+  fifo_frame_count = 0;
+  fifo_running = true;
+  return NRF_SUCCESS;
+}
+
+void mpu9250_fifo_stop() {
+  i2c_reg_write(MPU_ADDRESS, MPU9250_FIFO_EN, 0x00);
+  i2c_reg_write(MPU_ADDRESS, MPU9250_USER_CTRL, 0x04);
+  fifo_running = false;
+}
+
+uint16_t mpu9250_fifo_read(mpu9250_fifo_frame_t* frames, uint16_t max_frames, bool* overflow) {
+  *overflow = false;
+  if (!fifo_running) {
+    return 0;
+  }
+
+  // the overflow bit is cleared by reading INT_STATUS
+  if (i2c_reg_read(MPU_ADDRESS, MPU9250_INT_STATUS) & 0x10) {
+    // the fifo stopped accepting data when full, so its contents are stale
+    // and the gap length is unknown. Throw it away and start over, with the
+    // timestamps counting again from the reset
+    *overflow = true;
+    i2c_reg_write(MPU_ADDRESS, MPU9250_USER_CTRL, 0x44);
+    fifo_frame_count = 0;
+    return 0;
+  }
+
+  uint8_t count_buf[2] = {0};
+  i2c_burst_read(MPU_ADDRESS, MPU9250_FIFO_COUNTH, count_buf, 2);
+  uint16_t count = (((uint16_t)count_buf[0] & 0x1F) << 8) | count_buf[1];
+
+  // only whole frames are drained, a partial frame is left for next time
+  uint16_t num_frames = count / MPU9250_FIFO_FRAME_BYTES;
+  if (num_frames > max_frames) {
+    num_frames = max_frames;
+  }
+  if (num_frames > MPU9250_FIFO_MAX_DRAIN) {
+    num_frames = MPU9250_FIFO_MAX_DRAIN;
+  }
+  if (num_frames == 0) {
+    return 0;
+  }
+
+  // FIFO_R_W does not auto-increment, so one read drains sequential bytes
+  i2c_burst_read(MPU_ADDRESS, MPU9250_FIFO_R_W, fifo_buf, num_frames * MPU9250_FIFO_FRAME_BYTES);
+
+  for (uint16_t i = 0; i < num_frames; i++) {
+    const uint8_t* frame = &fifo_buf[i * MPU9250_FIFO_FRAME_BYTES];
+    frames[i].accel = unpack_accel(&frame[0]);
+    frames[i].gyro = unpack_gyro(&frame[6]);
+    frames[i].timestamp_us = (uint64_t)fifo_frame_count * fifo_period_us;
+    fifo_frame_count++;
+  }
+  return num_frames;
+}
+
+static void async_read_callback(ret_code_t result, void* p_context) {
+  // unpack before releasing the buffer so it cannot be rescheduled under us
+  uint8_t index = (uint8_t)(uintptr_t)p_context;
+  mpu9250_sample_t sample = mpu9250_unpack_sample(async_buf[index]);
+  async_in_flight--;
+  if (result == NRF_SUCCESS && async_callback != NULL) {
+    async_callback(sample);
+  }
+}
+
+void mpu9250_set_read_callback(mpu9250_read_callback* callback) {
+  async_callback = callback;
+}
+
+ret_code_t mpu9250_schedule_read() {
+  // both buffers are still owned by the bus or an unfinished callback
+  CRITICAL_REGION_ENTER();
+  if (async_in_flight >= 2) {
+    CRITICAL_REGION_EXIT();
+    return NRF_ERROR_BUSY;
+  }
+  uint8_t index = async_next_buf;
+  async_next_buf ^= 1;
+  async_in_flight++;
+  CRITICAL_REGION_EXIT();
+
+  ret_code_t error_code = nrf_twi_mngr_schedule(i2c_manager, &async_transaction[index]);
+  if (error_code != NRF_SUCCESS) {
+    // the buffer was never handed to the bus, so it is still next in line
+    CRITICAL_REGION_ENTER();
+    async_next_buf = index;
+    async_in_flight--;
+    CRITICAL_REGION_EXIT();
+  }
+  return error_code;
+}
+
+static void data_ready_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+  // each edge is exactly one new sample. If no buffer is free, skip this one
+  // rather than overwrite a buffer mid-transfer
+  if (mpu9250_schedule_read() != NRF_SUCCESS) {
+    data_ready_missed++;
+  } else {
+    LATENCY_MARK(LATENCY_READ_START);
+  }
+}
+
+ret_code_t mpu9250_start_data_ready(nrfx_gpiote_pin_t interrupt_pin, uint16_t sample_rate_hz, mpu9250_read_callback* callback) {
+  if (data_ready_running) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  if (sample_rate_hz < 4 || sample_rate_hz > 1000 || callback == NULL) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  data_ready_pin = interrupt_pin;
+
+  // setup gpiote interrupt, which the application may already have done
+  ret_code_t error_code = nrf_drv_gpiote_init();
+  if (error_code != NRF_SUCCESS && error_code != NRF_ERROR_INVALID_STATE) {
+    return error_code;
+  }
+  nrf_drv_gpiote_in_config_t int_gpio_config = GPIOTE_CONFIG_IN_SENSE_LOTOHI(true);
+  error_code = nrf_drv_gpiote_in_init(data_ready_pin, &int_gpio_config, data_ready_handler);
+  if (error_code != NRF_SUCCESS) {
+    return error_code;
+  }
+
+  data_ready_missed = 0;
+  mpu9250_set_read_callback(callback);
+
+  configure_sample_rate(sample_rate_hz, false);
+
+  // active high, push-pull, 50 us pulse per sample, keep bypass mode. A
+  // latched level would stay high after a dropped sample, since only the
+  // skipped read would have cleared it, and no further edges would arrive
+  i2c_reg_write(MPU_ADDRESS, MPU9250_INT_PIN_CFG, 0x02);
+  // interrupt on raw sensor data ready
+  i2c_reg_write(MPU_ADDRESS, MPU9250_INT_ENABLE, 0x01);
+
+  nrf_drv_gpiote_in_event_enable(data_ready_pin, true);
+  data_ready_running = true;
+
+  return NRF_SUCCESS;
+}
+
+void mpu9250_stop_data_ready() {
+  if (!data_ready_running) {
+    return;
+  }
+  nrf_drv_gpiote_in_event_disable(data_ready_pin);
+  nrf_drv_gpiote_in_uninit(data_ready_pin);
+  i2c_reg_write(MPU_ADDRESS, MPU9250_INT_ENABLE, 0x00);
+  i2c_reg_write(MPU_ADDRESS, MPU9250_INT_PIN_CFG, 0x02);
+  data_ready_running = false;
+}
+
+uint32_t mpu9250_data_ready_missed() {
+  return data_ready_missed;
+}
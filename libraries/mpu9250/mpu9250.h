@@ -4,7 +4,11 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "app_error.h"
+#include "nrf_drv_gpiote.h"
 #include "nrf_twi_mngr.h"
 
 // Types
@@ -15,6 +19,30 @@ typedef struct {
 	float z_axis;
 } mpu9250_measurement_t;
 
+typedef struct {
+	mpu9250_measurement_t accel;
+	float temperature;
+	mpu9250_measurement_t gyro;
+} mpu9250_sample_t;
+
+// Number of bytes from ACCEL_XOUT_H through GYRO_ZOUT_L
+#define MPU9250_SAMPLE_BYTES 14
+
+typedef struct {
+	mpu9250_measurement_t accel;
+	mpu9250_measurement_t gyro;
+	uint64_t timestamp_us; // reconstructed from the sample rate, relative to the fifo restart
+} mpu9250_fifo_frame_t;
+
+typedef void mpu9250_read_callback(mpu9250_sample_t sample);
+
+// Hardware fifo size in bytes
+#define MPU9250_FIFO_SIZE 512
+// Bytes per fifo frame: accel x/y/z followed by gyro x/y/z
+#define MPU9250_FIFO_FRAME_BYTES 12
+// Most frames drained per call, bounded by the 255-byte twi transfer length
+#define MPU9250_FIFO_MAX_DRAIN 21
+
 
 // Function prototypes
 
@@ -23,6 +51,17 @@ typedef struct {
 // i2c - pointer to already initialized and enabled twim instance
 void mpu9250_init(const nrf_twi_mngr_t* i2c);
 
+// Read accelerometer, temperature, and gyro in a single I2C transaction
+//
+// Return measurements as floating point values in g's, degrees C, and
+// degrees/second
+mpu9250_sample_t mpu9250_read_all();
+
+// Convert raw register contents into a sample
+//
+// buf - MPU9250_SAMPLE_BYTES bytes read starting at ACCEL_XOUT_H
+mpu9250_sample_t mpu9250_unpack_sample(const uint8_t* buf);
+
 // Read all three axes on the accelerometer
 //
 // Return measurements as floating point values in g's
@@ -55,6 +94,71 @@ void mpu9250_stop_gyro_integration();
 // Return the integrated value as floating point in degrees
 mpu9250_measurement_t mpu9250_read_gyro_integration();
 
+// Start batching accel and gyro samples into the hardware fifo
+//
+// sample_rate_hz - internal sample rate, 4 to 1000 Hz. Rates that do not
+//  divide 1 kHz evenly are rounded up to the next achievable rate
+//
+// Return an NRF error code
+//  - must be stopped before starting
+ret_code_t mpu9250_fifo_start(uint16_t sample_rate_hz);
+
+// Stop batching and reset the hardware fifo
+void mpu9250_fifo_stop();
+
+// Drain up to max_frames complete frames from the fifo
+//
+// Uses one FIFO_COUNT read and one bulk FIFO_R_W read. Each frame is given a
+// timestamp reconstructed from the configured sample rate, counting from the
+// last time the fifo was started or reset after an overflow.
+//
+// frames - output array with room for max_frames entries
+// overflow - set if the fifo filled up since the last call. The fifo is
+//  reset and no frames are returned in that case. How many samples were lost
+//  is unknown, so timestamps restart from zero at the reset, and the caller
+//  re-anchors them to its own clock
+//
+// Return the number of frames written into frames
+uint16_t mpu9250_fifo_read(mpu9250_fifo_frame_t* frames, uint16_t max_frames, bool* overflow);
+
+// Set the function called when a scheduled read completes
+//
+// The callback runs in the twi manager's interrupt context
+void mpu9250_set_read_callback(mpu9250_read_callback* callback);
+
+// Queue a non-blocking burst read of accel, temp, and gyro
+//
+// Reads alternate between two static buffers, so a new read may be scheduled
+// from the callback of the previous one while its sample is being processed.
+//
+// Return an NRF error code
+//  - NRF_ERROR_BUSY if both buffers are still in use
+ret_code_t mpu9250_schedule_read();
+
+// Start interrupt-driven acquisition on the MPU data-ready line
+//
+// Each rising edge on interrupt_pin schedules one burst read with
+// mpu9250_schedule_read(), and every fresh sample is handed to callback when
+// the read completes. This replaces any callback set with
+// mpu9250_set_read_callback(). With LATENCY_ENABLED, each edge that
+// schedules a read marks LATENCY_READ_START.
+//
+// interrupt_pin - gpio connected to the MPU INT pin (BUCKLER_IMU_INTERUPT)
+// sample_rate_hz - output data rate, 4 to 1000 Hz
+// callback - called once per sample
+//
+// Return an NRF error code
+//  - must be stopped before starting
+//  - errors from setting up gpiote are returned, and leave acquisition stopped
+ret_code_t mpu9250_start_data_ready(nrfx_gpiote_pin_t interrupt_pin, uint16_t sample_rate_hz, mpu9250_read_callback* callback);
+
+// Stop interrupt-driven acquisition and release the interrupt pin
+void mpu9250_stop_data_ready();
+
+// Return the number of data-ready edges dropped because both read buffers
+// were still in use
+uint32_t mpu9250_data_ready_missed();
+
 // Definitions
 
 typedef enum {
@@ -0,0 +1,292 @@
+// Servo driver
+//
+// The PWM runs at 1 MHz with a 20000 count top value, so compare values are
+// pulse widths in microseconds. Each frame is a one-entry sequence of
+// individual channel values, played from sequence 0 then sequence 1 in an
+// endless loop, and the peripheral loads the entry through EasyDMA when a
+// sequence starts. Writes fill the buffer the peripheral is not pointed at
+// and then repoint both sequences to it, so a buffer is never modified while
+// it can be loaded.
+//
+// Motion profiles step from the PWM interrupt at every frame boundary, so they
+// run at exactly the frame rate, and write only the channels they own. Writes
+// from the application are made in a critical region so they cannot swap
+// buffers in the middle of a profile update.
+//
+// Application updates are counted, and each swapped buffer records the
+// latest update it holds, so every frame knows which update it plays even
+// when the next one has already been requested. Unprofiled writes swap a
+// buffer right away, so they play from the next frame. A profiled request is
+// first stepped at the next frame boundary, after that frame has already
+// loaded its buffer, so it only plays from the frame after.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "nrfx_pwm.h"
+
+#include "servo.h"
+
+static const nrfx_pwm_t pwm = NRFX_PWM_INSTANCE(SERVO_PWM_INSTANCE);
+
+static servo_calibration_t calibrations[SERVO_CHANNELS];
+
+// values the peripheral plays, and which of them it is pointed at
+static nrf_pwm_values_individual_t buffers[2];
+static uint8_t active = 0;
+
+// latest value of every channel
+static uint16_t values[SERVO_CHANNELS];
+
+// motion profile of every channel, and the pulse width it is moving toward,
+// with 0 to ramp to the stop point and then turn off
+static motion_profile_t profiles[SERVO_CHANNELS];
+static bool profiled[SERVO_CHANNELS];
+static volatile uint16_t targets[SERVO_CHANNELS];
+
+// application updates requested, held by the buffer swapped in for the next
+// frame, and played by the current frame
+static volatile uint32_t requested = 0;
+static volatile uint32_t swapped = 0;
+static volatile uint32_t playing = 0;
+static volatile uint32_t frame_count = 0;
+static servo_frame_callback* frame_callback = NULL;
+
+// copy every channel value into the idle buffer and swap it in
+static void load_buffer(void) {
+  uint8_t next = active ^ 1;
+  nrf_pwm_values_individual_t* buffer = &buffers[next];
+  buffer->channel_0 = values[0] | SERVO_PULSE_POLARITY;
+  buffer->channel_1 = values[1] | SERVO_PULSE_POLARITY;
+  buffer->channel_2 = values[2] | SERVO_PULSE_POLARITY;
+  buffer->channel_3 = values[3] | SERVO_PULSE_POLARITY;
+
+  nrf_pwm_seq_ptr_set(pwm.p_registers, 0, (const uint16_t*)buffer);
+  nrf_pwm_seq_ptr_set(pwm.p_registers, 1, (const uint16_t*)buffer);
+  active = next;
+  swapped = requested;
+}
+
+// output the latest values from the next frame
+static void write_values(void) {
+  CRITICAL_REGION_ENTER();
+  requested++;
+  load_buffer();
+  CRITICAL_REGION_EXIT();
+}
+
+// advance every profiled channel one frame toward its target
+static void step_profiles(void) {
+  bool changed = false;
+  for (int i = 0; i < SERVO_CHANNELS; i++) {
+    uint16_t target = targets[i];
+    if (!profiled[i] || (target == 0 && values[i] == 0)) {
+      continue;
+    }
+
+    float goal = target ? target : calibrations[i].stop_us;
+    float position = motion_update(&profiles[i], goal);
+    uint16_t value = (uint16_t)(position + 0.5f);
+    if (target == 0 && motion_settled(&profiles[i], goal)) {
+      value = 0;
+    }
+    if (value != values[i]) {
+      values[i] = value;
+      changed = true;
+    }
+  }
+
+  if (changed) {
+    load_buffer();
+  } else {
+    // requests that leave the output as it is are applied as well
+    swapped = requested;
+  }
+}
+
+static void pwm_handler(nrfx_pwm_evt_type_t event_type) {
+  if (event_type == NRFX_PWM_EVT_END_SEQ0 || event_type == NRFX_PWM_EVT_END_SEQ1) {
+    // the next sequence has loaded the buffer swapped in before this event
+    playing = swapped;
+    frame_count++;
+    step_profiles();
+    if (frame_callback) {
+      frame_callback(frame_count, playing);
+    }
+  }
+}
+
+ret_code_t servo_init(const uint8_t* pins, uint8_t count, const servo_calibration_t* calibration) {
+  if (count > SERVO_CHANNELS) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+
+  nrfx_pwm_config_t config = NRFX_PWM_DEFAULT_CONFIG;
+  for (int i = 0; i < SERVO_CHANNELS; i++) {
+    config.output_pins[i] = (i < count) ? pins[i] : NRFX_PWM_PIN_NOT_USED;
+    calibrations[i] = *calibration;
+    values[i] = 0;
+    targets[i] = 0;
+    profiled[i] = false;
+  }
+  config.base_clock = NRF_PWM_CLK_1MHz;
+  config.count_mode = NRF_PWM_MODE_UP;
+  config.top_value = SERVO_PERIOD_US;
+  config.load_mode = NRF_PWM_LOAD_INDIVIDUAL;
+  config.step_mode = NRF_PWM_STEP_AUTO;
+
+  ret_code_t error_code = nrfx_pwm_init(&pwm, &config, pwm_handler);
+  if (error_code != NRF_SUCCESS) {
+    return error_code;
+  }
+
+  memset(buffers, 0, sizeof(buffers));
+  for (int i = 0; i < 2; i++) {
+    buffers[i].channel_0 = SERVO_PULSE_POLARITY;
+    buffers[i].channel_1 = SERVO_PULSE_POLARITY;
+    buffers[i].channel_2 = SERVO_PULSE_POLARITY;
+    buffers[i].channel_3 = SERVO_PULSE_POLARITY;
+  }
+  active = 0;
+  requested = 0;
+  swapped = 0;
+  playing = 0;
+  frame_count = 0;
+
+  nrf_pwm_sequence_t sequence = {
+    .values.p_individual = &buffers[active],
+    .length = NRF_PWM_VALUES_LENGTH(buffers[active]),
+    .repeats = 0,
+    .end_delay = 0,
+  };
+  nrfx_pwm_simple_playback(&pwm, &sequence, 1,
+      NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_SIGNAL_END_SEQ0 | NRFX_PWM_FLAG_SIGNAL_END_SEQ1);
+  return NRF_SUCCESS;
+}
+
+void servo_calibrate(uint8_t channel, const servo_calibration_t* calibration) {
+  if (channel < SERVO_CHANNELS) {
+    calibrations[channel] = *calibration;
+  }
+}
+
+void servo_set_pulse_us(uint8_t channel, uint16_t pulse_us) {
+  if (channel >= SERVO_CHANNELS) {
+    return;
+  }
+
+  const servo_calibration_t* calibration = &calibrations[channel];
+  if (pulse_us < calibration->min_us) {
+    pulse_us = calibration->min_us;
+  } else if (pulse_us > calibration->max_us) {
+    pulse_us = calibration->max_us;
+  }
+
+  if (profiled[channel]) {
+    // the profile writes the value at the next frame boundary
+    CRITICAL_REGION_ENTER();
+    requested++;
+    targets[channel] = pulse_us;
+    CRITICAL_REGION_EXIT();
+  } else {
+    values[channel] = pulse_us;
+    write_values();
+  }
+}
+
+void servo_set_speed(uint8_t channel, float speed) {
+  if (channel >= SERVO_CHANNELS) {
+    return;
+  }
+
+  const servo_calibration_t* calibration = &calibrations[channel];
+  uint16_t half_deadband = calibration->deadband_us / 2;
+
+  float pulse_us = calibration->stop_us;
+  if (speed > 0) {
+    float start = calibration->stop_us + half_deadband;
+    pulse_us = start + (speed > 1.0f ? 1.0f : speed) * (calibration->max_us - start);
+  } else if (speed < 0) {
+    float start = calibration->stop_us - half_deadband;
+    pulse_us = start + (speed < -1.0f ? -1.0f : speed) * (start - calibration->min_us);
+  }
+  servo_set_pulse_us(channel, (uint16_t)(pulse_us + 0.5f));
+}
+
+float servo_get_speed(uint8_t channel) {
+  if (channel >= SERVO_CHANNELS) {
+    return 0;
+  }
+
+  // the inverse of servo_set_speed
+  const servo_calibration_t* calibration = &calibrations[channel];
+  uint16_t half_deadband = calibration->deadband_us / 2;
+  uint16_t pulse_us = values[channel];
+  if (pulse_us == 0) {
+    return 0;
+  } else if (pulse_us > calibration->stop_us + half_deadband) {
+    float start = calibration->stop_us + half_deadband;
+    return (pulse_us - start) / (calibration->max_us - start);
+  } else if (pulse_us < calibration->stop_us - half_deadband) {
+    float start = calibration->stop_us - half_deadband;
+    return (pulse_us - start) / (start - calibration->min_us);
+  }
+  return 0;
+}
+
+void servo_off(uint8_t channel) {
+  if (channel >= SERVO_CHANNELS) {
+    return;
+  }
+
+  if (profiled[channel]) {
+    CRITICAL_REGION_ENTER();
+    requested++;
+    targets[channel] = 0;
+    CRITICAL_REGION_EXIT();
+  } else {
+    values[channel] = 0;
+    write_values();
+  }
+}
+
+void servo_set_motion(uint8_t channel, const motion_config_t* config) {
+  if (channel >= SERVO_CHANNELS) {
+    return;
+  }
+
+  CRITICAL_REGION_ENTER();
+  if (config) {
+    // start from the current output, or from rest at the stop point
+    float position = values[channel] ? values[channel] : calibrations[channel].stop_us;
+    motion_init(&profiles[channel], config, SERVO_PERIOD_US / 1000000.0f, position);
+    targets[channel] = values[channel];
+    profiled[channel] = true;
+  } else {
+    // jump to where the profile was heading
+    profiled[channel] = false;
+    values[channel] = targets[channel];
+    requested++;
+    load_buffer();
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+bool servo_update_pending(void) {
+  return playing != requested;
+}
+
+uint32_t servo_update_count(void) {
+  return requested;
+}
+
+uint32_t servo_frame_count(void) {
+  return frame_count;
+}
+
+void servo_set_frame_callback(servo_frame_callback* callback) {
+  frame_callback = callback;
+}
@@ -0,0 +1,119 @@
+// Servo driver
+//
+// Drives up to four hobby servos from the hardware PWM peripheral with pulse
+// widths in microseconds. The peripheral reads pulse widths by EasyDMA at the
+// start of every 20 ms frame, so updates never block: they are written to a
+// second buffer that is swapped in and takes effect at the next frame
+// boundary. An optional callback reports each frame boundary, and which
+// update it plays.
+//
+// A servo can also be given a motion profile, which limits how fast its pulse
+// width may change. Its pulse then moves toward the latest requested width by
+// one velocity and acceleration limited step per frame, and turning it off
+// first ramps it back to the stop point. The first step is taken at the next
+// frame boundary, so a profiled update plays one frame later.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+#include "motion.h"
+
+// Configuration
+
+// hardware PWM instance used for the servos
+#ifndef SERVO_PWM_INSTANCE
+#define SERVO_PWM_INSTANCE 0
+#endif
+
+// polarity bit of each pulse value, 0x8000 makes the pulse the high part of
+// the frame
+#ifndef SERVO_PULSE_POLARITY
+#define SERVO_PULSE_POLARITY 0x8000
+#endif
+
+#define SERVO_CHANNELS 4
+#define SERVO_PERIOD_US 20000
+
+// Types
+
+// per-servo calibration, all in microseconds
+typedef struct {
+  uint16_t min_us;      // shortest pulse the servo accepts
+  uint16_t max_us;      // longest pulse the servo accepts
+  uint16_t stop_us;     // pulse at which a continuous servo stands still
+  uint16_t deadband_us; // width around stop_us the servo does not respond to
+} servo_calibration_t;
+
+// called from the PWM interrupt at every frame boundary
+//
+// update - servo_update_count() of the latest update the frame starting now
+//  plays, which for a profiled servo is the first step toward it
+typedef void servo_frame_callback(uint32_t frame, uint32_t update);
+
+// Calibration for a typical continuous rotation microservo
+#define SERVO_DEFAULT_CALIBRATION { \
+  .min_us = 1000,                   \
+  .max_us = 2000,                   \
+  .stop_us = 1500,                  \
+  .deadband_us = 10,                \
+}
+
+
+// Function prototypes
+
+// Initialize the PWM peripheral and start outputting frames, with no pulses
+//
+// pins - output pin of each servo, in channel order
+// count - number of servos, up to SERVO_CHANNELS
+// calibration - pulse limits and stop point applied to every servo
+ret_code_t servo_init(const uint8_t* pins, uint8_t count, const servo_calibration_t* calibration);
+
+// Change the calibration of one servo
+void servo_calibrate(uint8_t channel, const servo_calibration_t* calibration);
+
+// Output a pulse width, clamped to the calibrated range, from the next frame
+void servo_set_pulse_us(uint8_t channel, uint16_t pulse_us);
+
+// Output a speed for a continuous servo from the next frame
+//
+// speed - -1.0 to 1.0, mapped from the edges of the deadband to min/max so
+//  any nonzero speed moves the servo
+void servo_set_speed(uint8_t channel, float speed);
+
+// Return the speed a continuous servo is output at from the next frame
+//
+// This is the pulse width actually written, after any motion profile, so it
+// lags the requested speed while the profile ramps. 0 when off or within the
+// deadband
+float servo_get_speed(uint8_t channel);
+
+// Stop outputting pulses from the next frame, which lets the servo go limp
+//
+// A profiled servo ramps to its stop point first and stops at the frame it
+// gets there
+void servo_off(uint8_t channel);
+
+// Limit the rate of change of a servo's pulse width
+//
+// config - maximum velocity in microseconds per second and acceleration in
+//  microseconds per second squared, NULL to output requests directly
+void servo_set_motion(uint8_t channel, const motion_config_t* config);
+
+// Return true if an update has been written but its frame has not started
+//
+// A profiled update is stepped at the next frame boundary and played from the
+// frame after, so it stays pending for one frame longer than a direct one
+bool servo_update_pending(void);
+
+// Return the number of updates requested since servo_init, counting every
+// pulse width, speed, and off request
+uint32_t servo_update_count(void);
+
+// Return the number of frame boundaries since servo_init
+uint32_t servo_frame_count(void);
+
+// Set a function to call at every frame boundary, NULL to disable
+void servo_set_frame_callback(servo_frame_callback* callback);
@@ -0,0 +1,181 @@
+// Fixed-point spectral analysis
+//
+// The real FFT packs n real samples into n/2 complex ones, runs a radix-2
+// decimation-in-time complex FFT on them, and splits the result back into the
+// spectrum of the real signal. Every butterfly stage halves its outputs, and
+// the split stage halves once more, for an overall 1/n scale.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spectrum.h"
+
+// quarter wave of sin(2*pi*i/SPECTRUM_MAX_SIZE) in Q15
+static const int16_t SINE_TABLE[SPECTRUM_MAX_SIZE / 4 + 1] = {
+  0, 402, 804, 1206, 1608, 2009, 2410, 2811,
+  3212, 3612, 4011, 4410, 4808, 5205, 5602, 5998,
+  6393, 6786, 7179, 7571, 7962, 8351, 8739, 9126,
+  9512, 9896, 10278, 10659, 11039, 11417, 11793, 12167,
+  12539, 12910, 13279, 13645, 14010, 14372, 14732, 15090,
+  15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+  18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475,
+  20787, 21096, 21403, 21705, 22005, 22301, 22594, 22884,
+  23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072,
+  25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019,
+  27245, 27466, 27683, 27896, 28105, 28310, 28510, 28706,
+  28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+  30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237,
+  31356, 31470, 31580, 31685, 31785, 31880, 31971, 32057,
+  32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+  32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765,
+  32767,
+};
+
+#define QUARTER (SPECTRUM_MAX_SIZE / 4)
+
+// sin(2*pi*i/SPECTRUM_MAX_SIZE) in Q15, i in [0, SPECTRUM_MAX_SIZE)
+static int32_t sin_q15(uint32_t i) {
+  uint32_t r = i % QUARTER;
+  switch (i / QUARTER) {
+    case 0: return SINE_TABLE[r];
+    case 1: return SINE_TABLE[QUARTER - r];
+    case 2: return -SINE_TABLE[r];
+    default: return -SINE_TABLE[QUARTER - r];
+  }
+}
+
+static int32_t cos_q15(uint32_t i) {
+  return sin_q15((i + QUARTER) % SPECTRUM_MAX_SIZE);
+}
+
+static int16_t saturate(int32_t x) {
+  if (x > INT16_MAX) {
+    return INT16_MAX;
+  } else if (x < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)x;
+}
+
+// Q15 multiply with rounding
+static int32_t mul_q15(int32_t a, int32_t b) {
+  return (a * b + (1 << 14)) >> 15;
+}
+
+bool spectrum_valid_size(uint16_t n) {
+  return n >= 4 && n <= SPECTRUM_MAX_SIZE && (n & (n - 1)) == 0;
+}
+
+void spectrum_hann(int16_t* samples, uint16_t n) {
+  uint32_t stride = SPECTRUM_MAX_SIZE / n;
+  for (uint32_t i = 0; i < n; i++) {
+    // w = (1 - cos) / 2, kept as 1 - cos in Q15 and halved in the shift
+    int32_t w = 32768 - cos_q15(i * stride);
+    samples[i] = (int16_t)((samples[i] * w) >> 16);
+  }
+}
+
+// radix-2 complex FFT of m interleaved complex values, scaled by 1/m
+static void complex_fft(int16_t* data, uint32_t m) {
+  // bit reversal permutation
+  for (uint32_t i = 1, j = 0; i < m; i++) {
+    uint32_t bit = m >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j |= bit;
+    if (i < j) {
+      int16_t re = data[2*i];
+      int16_t im = data[2*i + 1];
+      data[2*i] = data[2*j];
+      data[2*i + 1] = data[2*j + 1];
+      data[2*j] = re;
+      data[2*j + 1] = im;
+    }
+  }
+
+  // butterflies, halving every stage
+  for (uint32_t len = 2; len <= m; len <<= 1) {
+    uint32_t half = len >> 1;
+    uint32_t stride = SPECTRUM_MAX_SIZE / len;
+    for (uint32_t k = 0; k < half; k++) {
+      int32_t wr = cos_q15(k * stride);
+      int32_t wi = -sin_q15(k * stride);
+      for (uint32_t i = k; i < m; i += len) {
+        uint32_t j = i + half;
+        int32_t br = data[2*j];
+        int32_t bi = data[2*j + 1];
+        int32_t tr = mul_q15(br, wr) - mul_q15(bi, wi);
+        int32_t ti = mul_q15(br, wi) + mul_q15(bi, wr);
+        int32_t ar = data[2*i];
+        int32_t ai = data[2*i + 1];
+        data[2*i] = saturate((ar + tr) >> 1);
+        data[2*i + 1] = saturate((ai + ti) >> 1);
+        data[2*j] = saturate((ar - tr) >> 1);
+        data[2*j + 1] = saturate((ai - ti) >> 1);
+      }
+    }
+  }
+}
+
+void spectrum_rfft(int16_t* samples, uint16_t n) {
+  uint32_t m = n / 2;
+  complex_fft(samples, m);
+
+  // split Z = FFT(x[2i] + j*x[2i+1]) into the spectrum X of x:
+  //  E = (Z[k] + conj(Z[m-k])) / 2
+  //  O = -j * (Z[k] - conj(Z[m-k])) / 2
+  //  X[k] = E + W^k * O,  X[m-k] = conj(E - W^k * O),  W = exp(-2*pi*j/n)
+  int32_t z0r = samples[0];
+  int32_t z0i = samples[1];
+  samples[0] = saturate((z0r + z0i) >> 1);
+  samples[1] = saturate((z0r - z0i) >> 1);
+
+  uint32_t stride = SPECTRUM_MAX_SIZE / n;
+  for (uint32_t k = 1; k <= m / 2; k++) {
+    uint32_t l = m - k;
+    int32_t ar = samples[2*k];
+    int32_t ai = samples[2*k + 1];
+    int32_t br = samples[2*l];
+    int32_t bi = samples[2*l + 1];
+
+    // E and O at twice their value, the final shift provides the halving
+    int32_t er = ar + br;
+    int32_t ei = ai - bi;
+    int32_t odd_r = ai + bi;
+    int32_t odd_i = br - ar;
+
+    int32_t wr = cos_q15(k * stride);
+    int32_t wi = -sin_q15(k * stride);
+    int32_t tr = mul_q15(odd_r, wr) - mul_q15(odd_i, wi);
+    int32_t ti = mul_q15(odd_r, wi) + mul_q15(odd_i, wr);
+
+    // X is halved twice: once for E and O, once for the 1/n output scale
+    samples[2*k] = saturate((er + tr) >> 2);
+    samples[2*k + 1] = saturate((ei + ti) >> 2);
+    if (l != k) {
+      samples[2*l] = saturate((er - tr) >> 2);
+      samples[2*l + 1] = saturate((ti - ei) >> 2);
+    }
+  }
+}
+
+void spectrum_psd(const int16_t* fft, uint16_t n, float sample_rate_hz, float scale, float* psd) {
+  // fft holds X/n; a Hann window has sum(w^2) = 3n/8, so the one-sided density
+  //  2*|X|^2 / (fs * sum(w^2)) becomes (16n / 3fs) * |fft|^2 away from DC and
+  //  Nyquist, which are not doubled
+  float norm = 8.0f * n / (3.0f * sample_rate_hz * scale * scale);
+  uint16_t half = n / 2;
+
+  psd[0] = norm * (float)fft[0] * fft[0];
+  psd[half] = norm * (float)fft[1] * fft[1];
+  for (uint16_t k = 1; k < half; k++) {
+    float re = fft[2*k];
+    float im = fft[2*k + 1];
+    psd[k] = 2.0f * norm * (re * re + im * im);
+  }
+}
+
+float spectrum_bin_hz(uint16_t bin, uint16_t n, float sample_rate_hz) {
+  return bin * sample_rate_hz / n;
+}
@@ -0,0 +1,45 @@
+// Fixed-point spectral analysis
+//
+// In-place real FFT on Q15 samples with Hann windowing and a power spectral
+// density estimate. Twiddles come from a const sine table kept in flash, so
+// there is no initialization and no RAM beyond the caller's buffer. Plain C
+// with no SDK dependencies, so it also builds for host analysis tools.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Configuration
+
+// largest supported transform, sets the resolution of the twiddle table
+#define SPECTRUM_MAX_SIZE 512
+
+
+// Function prototypes
+
+// Return true if n is a supported transform size (power of two, 4 to
+//  SPECTRUM_MAX_SIZE)
+bool spectrum_valid_size(uint16_t n);
+
+// Multiply n samples by a Hann window, in place
+void spectrum_hann(int16_t* samples, uint16_t n);
+
+// Real FFT of n samples, in place
+//
+// Output is scaled by 1/n so it cannot overflow, and packed as
+//  samples[0] = X[0], samples[1] = X[n/2] (both purely real)
+//  samples[2k], samples[2k+1] = real, imaginary parts of X[k], 0 < k < n/2
+void spectrum_rfft(int16_t* samples, uint16_t n);
+
+// Power spectral density of a Hann windowed spectrum from spectrum_rfft
+//
+// fft - packed output of spectrum_rfft
+// n - transform size
+// sample_rate_hz - rate the samples were taken at
+// scale - LSBs per input unit the samples were quantized with
+// psd - n/2+1 one-sided densities in input units squared per Hz
+void spectrum_psd(const int16_t* fft, uint16_t n, float sample_rate_hz, float scale, float* psd);
+
+// Return the center frequency of a bin
+float spectrum_bin_hz(uint16_t bin, uint16_t n, float sample_rate_hz);
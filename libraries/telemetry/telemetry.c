@@ -0,0 +1,90 @@
+// Binary telemetry
+//
+// The writer only advances head and the reader only advances tail, each
+// after a memory barrier that publishes the record before the index, so
+// neither needs to lock the other out. Both indices count up freely and are
+// masked on access, which keeps a full ring distinguishable from an empty
+// one.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "SEGGER_RTT.h"
+
+#include "telemetry.h"
+
+#define RING_MASK (TELEMETRY_RING_SIZE - 1)
+
+_Static_assert((TELEMETRY_RING_SIZE & RING_MASK) == 0, "TELEMETRY_RING_SIZE must be a power of two");
+
+static telemetry_record_t ring[TELEMETRY_RING_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+
+static volatile uint32_t dropped = 0;
+static uint16_t sequence = 0;
+
+static uint8_t rtt_buffer[TELEMETRY_RTT_BUFFER_SIZE];
+
+bool telemetry_write(const telemetry_record_t* record) {
+  uint32_t index = head;
+
+  // dropped records still take a sequence number, so gaps show in the stream
+  uint16_t number = sequence++;
+  if (index - tail >= TELEMETRY_RING_SIZE) {
+    dropped++;
+    return false;
+  }
+
+  telemetry_record_t* slot = &ring[index & RING_MASK];
+  *slot = *record;
+  slot->sequence = number;
+  slot->dropped = (dropped > UINT16_MAX) ? UINT16_MAX : dropped;
+
+  // publish the record before the index that makes it visible
+  __DMB();
+  head = index + 1;
+  return true;
+}
+
+uint32_t telemetry_drain(telemetry_sink* sink) {
+  uint32_t index = tail;
+  uint32_t end = head;
+  __DMB();
+
+  uint32_t sent = 0;
+  while (index != end) {
+    // records up to the end of the ring or the newest, whichever is first
+    uint32_t offset = index & RING_MASK;
+    uint32_t count = end - index;
+    if (offset + count > TELEMETRY_RING_SIZE) {
+      count = TELEMETRY_RING_SIZE - offset;
+    }
+
+    uint32_t accepted = sink(&ring[offset], count * sizeof(telemetry_record_t)) / sizeof(telemetry_record_t);
+
+    // finish reading the records before the writer may reuse their slots
+    __DMB();
+    index += accepted;
+    tail = index;
+    sent += accepted;
+    if (accepted < count) {
+      break;
+    }
+  }
+  return sent;
+}
+
+uint32_t telemetry_dropped(void) {
+  return dropped;
+}
+
+void telemetry_rtt_init(void) {
+  SEGGER_RTT_ConfigUpBuffer(TELEMETRY_RTT_CHANNEL, "Telemetry", rtt_buffer, sizeof(rtt_buffer),
+      SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+}
+
+uint32_t telemetry_rtt_sink(const void* data, uint32_t length) {
+  return SEGGER_RTT_Write(TELEMETRY_RTT_CHANNEL, data, length);
+}
@@ -0,0 +1,94 @@
+// Binary telemetry
+//
+// Fixed-size records of the control loop state, queued in a RAM ring and
+// drained in bulk from the main loop, so the control step never waits on
+// formatting or output. The ring is lock-free for one writer and one reader:
+// records may be written from an interrupt while the main loop drains. When
+// the ring is full new records are dropped and counted, never blocking.
+//
+// Records are little-endian and written byte for byte, so the host decoder in
+// tools/telemetry_decode reads the same struct back.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Configuration
+
+// number of records the ring holds, must be a power of two
+#ifndef TELEMETRY_RING_SIZE
+#define TELEMETRY_RING_SIZE 64
+#endif
+
+// RTT up channel and buffer size used by telemetry_rtt_sink, kept off
+// channel 0 so the binary stream does not mix with printf
+#ifndef TELEMETRY_RTT_CHANNEL
+#define TELEMETRY_RTT_CHANNEL 1
+#endif
+#ifndef TELEMETRY_RTT_BUFFER_SIZE
+#define TELEMETRY_RTT_BUFFER_SIZE 1024
+#endif
+
+// fixed point scales of the record fields
+#define TELEMETRY_GYRO_SCALE 16.0    // LSBs per degree/second
+#define TELEMETRY_ACCEL_SCALE 1000.0 // LSBs per g
+#define TELEMETRY_ANGLE_SCALE 32.0   // LSBs per degree, saturating at 1024
+#define TELEMETRY_COMMAND_SCALE 32767.0 // LSBs per full servo speed
+
+#define TELEMETRY_SERVOS 2
+
+// Types
+
+typedef struct {
+  uint32_t timestamp_us; // read_timer() when the IMU read started
+  uint16_t sequence;     // set on write, counts dropped records too
+  uint16_t dropped;      // set on write, records dropped so far, saturating
+  int16_t gyro[3];       // x, y, z
+  int16_t accel[3];      // x, y, z
+  int16_t angle[3];      // x, y, z
+  uint8_t tremor;        // bit per servo channel, set while tremor is detected
+  uint8_t reserved;
+  int16_t command[TELEMETRY_SERVOS]; // servo speed, 0 for off
+} telemetry_record_t;
+
+_Static_assert(sizeof(telemetry_record_t) == 32, "telemetry records must stay 32 bytes");
+
+// Writes bytes to an output and returns how many it accepted. Telemetry only
+// counts whole records as sent, so sinks should accept all or nothing.
+typedef uint32_t telemetry_sink(const void* data, uint32_t length);
+
+// Quantize a value to a record field, saturating
+static inline int16_t telemetry_quantize(float value, float scale) {
+  float scaled = value * scale;
+  if (scaled >= INT16_MAX) {
+    return INT16_MAX;
+  } else if (scaled <= INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+}
+
+
+// Function prototypes
+
+// Queue a record, filling in its sequence number and dropped count
+//
+// Return false if the ring was full and the record was dropped
+bool telemetry_write(const telemetry_record_t* record);
+
+// Send queued records to a sink, in as few calls as the ring layout allows
+// Call from the main loop, at lower priority than the writer
+//
+// Return the number of records sent
+uint32_t telemetry_drain(telemetry_sink* sink);
+
+// Return the number of records dropped because the ring was full
+uint32_t telemetry_dropped(void);
+
+// Set up the RTT channel for telemetry_rtt_sink
+void telemetry_rtt_init(void);
+
+// Sink that writes to the telemetry RTT channel without blocking, all or
+// nothing
+uint32_t telemetry_rtt_sink(const void* data, uint32_t length);
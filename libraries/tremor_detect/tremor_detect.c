@@ -0,0 +1,86 @@
+// Streaming tremor detector
+//
+// The band-pass is a 2nd order Butterworth highpass at low_hz cascaded with a
+// 2nd order Butterworth lowpass at high_hz, which rejects slow voluntary
+// motion more steeply than a single band-pass biquad.
+// Filter design: https://www.w3.org/TR/audio-eq-cookbook/
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "tremor_detect.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// butterworth quality factor
+static const float BUTTERWORTH_Q = 0.70710678f;
+
+static void biquad_set(biquad_t* filter, float b0, float b1, float b2, float a0, float a1, float a2) {
+  memset(filter, 0, sizeof(biquad_t));
+  filter->b0 = b0 / a0;
+  filter->b1 = b1 / a0;
+  filter->b2 = b2 / a0;
+  filter->a1 = a1 / a0;
+  filter->a2 = a2 / a0;
+}
+
+void biquad_init_highpass(biquad_t* filter, float sample_rate_hz, float cutoff_hz) {
+  float w0 = 2.0f * (float)M_PI * cutoff_hz / sample_rate_hz;
+  float cos_w0 = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * BUTTERWORTH_Q);
+  biquad_set(filter,
+      (1.0f + cos_w0) / 2.0f, -(1.0f + cos_w0), (1.0f + cos_w0) / 2.0f,
+      1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+}
+
+void biquad_init_lowpass(biquad_t* filter, float sample_rate_hz, float cutoff_hz) {
+  float w0 = 2.0f * (float)M_PI * cutoff_hz / sample_rate_hz;
+  float cos_w0 = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * BUTTERWORTH_Q);
+  biquad_set(filter,
+      (1.0f - cos_w0) / 2.0f, 1.0f - cos_w0, (1.0f - cos_w0) / 2.0f,
+      1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+}
+
+float biquad_process(biquad_t* filter, float x) {
+  float y = filter->b0 * x + filter->b1 * filter->x1 + filter->b2 * filter->x2
+          - filter->a1 * filter->y1 - filter->a2 * filter->y2;
+  filter->x2 = filter->x1;
+  filter->x1 = x;
+  filter->y2 = filter->y1;
+  filter->y1 = y;
+  return y;
+}
+
+void tremor_detect_init(tremor_detect_t* detector, const tremor_detect_config_t* config) {
+  biquad_init_highpass(&detector->highpass, config->sample_rate_hz, config->low_hz);
+  biquad_init_lowpass(&detector->lowpass, config->sample_rate_hz, config->high_hz);
+
+  // one-pole smoothing with the requested time constant
+  detector->alpha = 1.0f - expf(-1.0f / (config->time_constant_s * config->sample_rate_hz));
+  detector->mean_square = 0;
+
+  // compare squared values so the per-sample path needs no square root
+  detector->on_square = config->on_threshold * config->on_threshold;
+  detector->off_square = config->off_threshold * config->off_threshold;
+  detector->active = false;
+}
+
+bool tremor_detect_update(tremor_detect_t* detector, float sample) {
+  float band = biquad_process(&detector->lowpass, biquad_process(&detector->highpass, sample));
+  detector->mean_square += detector->alpha * (band * band - detector->mean_square);
+
+  if (!detector->active && detector->mean_square > detector->on_square) {
+    detector->active = true;
+  } else if (detector->active && detector->mean_square < detector->off_square) {
+    detector->active = false;
+  }
+  return detector->active;
+}
+
+float tremor_detect_rms(const tremor_detect_t* detector) {
+  return sqrtf(detector->mean_square);
+}
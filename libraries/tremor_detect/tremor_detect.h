@@ -0,0 +1,78 @@
+// Streaming tremor detector
+//
+// Band-passes a motion signal (e.g. gyro rate) to the tremor band, tracks the
+// band energy with an exponential RMS estimator, and reports tremor with
+// hysteresis. One sample per call, constant time and memory.
+
+#pragma once
+
+#include <stdbool.h>
+
+// Types
+
+// Direct form I biquad section
+typedef struct {
+  float b0, b1, b2;
+  float a1, a2;
+  float x1, x2;
+  float y1, y2;
+} biquad_t;
+
+typedef struct {
+  float sample_rate_hz;   // rate tremor_detect_update is called at
+  float low_hz;           // lower edge of the tremor band
+  float high_hz;          // upper edge of the tremor band
+  float time_constant_s;  // averaging time of the RMS estimator
+  float on_threshold;     // band RMS above which tremor is reported
+  float off_threshold;    // band RMS below which tremor stops being reported
+} tremor_detect_config_t;
+
+typedef struct {
+  biquad_t highpass;
+  biquad_t lowpass;
+  float alpha;
+  float mean_square;
+  float on_square;
+  float off_square;
+  bool active;
+} tremor_detect_t;
+
+// Default configuration for a 50 Hz gyro stream in degrees/second
+//  3-12 Hz band, 200 ms averaging
+#define TREMOR_DETECT_DEFAULT_CONFIG { \
+  .sample_rate_hz = 50.0,              \
+  .low_hz = 3.0,                       \
+  .high_hz = 12.0,                     \
+  .time_constant_s = 0.2,              \
+  .on_threshold = 15.0,                \
+  .off_threshold = 8.0,                \
+}
+
+
+// Function prototypes
+
+// Configure a biquad as a 2nd order Butterworth highpass or lowpass filter
+//
+// sample_rate_hz - rate samples are processed at
+// cutoff_hz - -3 dB frequency, must be below half the sample rate
+void biquad_init_highpass(biquad_t* filter, float sample_rate_hz, float cutoff_hz);
+void biquad_init_lowpass(biquad_t* filter, float sample_rate_hz, float cutoff_hz);
+
+// Filter one sample
+//
+// Return the filtered sample
+float biquad_process(biquad_t* filter, float x);
+
+// Initialize a detector
+//
+// detector - state to initialize, owned by the caller
+// config - filter band, averaging time, and thresholds
+void tremor_detect_init(tremor_detect_t* detector, const tremor_detect_config_t* config);
+
+// Process one sample
+//
+// Return true while tremor is detected
+bool tremor_detect_update(tremor_detect_t* detector, float sample);
+
+// Return the current RMS of the band-passed signal
+float tremor_detect_rms(const tremor_detect_t* detector);
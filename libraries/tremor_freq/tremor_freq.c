@@ -0,0 +1,149 @@
+// Sliding DFT tremor frequency tracker
+//
+// Bins are kept relative to a fixed phase reference instead of the usual
+// rotating one: sample n is added to bin k with twiddle W^(k * (n mod N)), and
+// leaves the window N samples later with the same twiddle. Additions and
+// removals therefore cancel exactly in integer arithmetic, so the bins never
+// drift the way a recursive floating or fixed-point sliding DFT does. The
+// phase offset this introduces does not change bin magnitudes.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tremor_freq.h"
+
+#if TREMOR_FREQ_WINDOW != 100
+#error "the twiddle table below is generated for a window of 100 samples"
+#endif
+
+// sin(2*pi*i/TREMOR_FREQ_WINDOW) in Q15 over one and a quarter periods, so
+// cos(2*pi*i/TREMOR_FREQ_WINDOW) is SINE_TABLE[i + TREMOR_FREQ_WINDOW / 4]
+static const int16_t SINE_TABLE[TREMOR_FREQ_WINDOW + TREMOR_FREQ_WINDOW / 4] = {
+  0, 2057, 4107, 6140, 8149, 10126, 12062, 13952, 15786, 17557,
+  19260, 20886, 22431, 23886, 25247, 26509, 27666, 28714, 29648, 30466,
+  31163, 31738, 32187, 32509, 32702, 32767, 32702, 32509, 32187, 31738,
+  31163, 30466, 29648, 28714, 27666, 26509, 25247, 23886, 22431, 20886,
+  19260, 17557, 15786, 13952, 12062, 10126, 8149, 6140, 4107, 2057,
+  0, -2057, -4107, -6140, -8149, -10126, -12062, -13952, -15786, -17557,
+  -19260, -20886, -22431, -23886, -25247, -26509, -27666, -28714, -29648, -30466,
+  -31163, -31738, -32187, -32509, -32702, -32767, -32702, -32509, -32187, -31738,
+  -31163, -30466, -29648, -28714, -27666, -26509, -25247, -23886, -22431, -20886,
+  -19260, -17557, -15786, -13952, -12062, -10126, -8149, -6140, -4107, -2057,
+  0, 2057, 4107, 6140, 8149, 10126, 12062, 13952, 15786, 17557,
+  19260, 20886, 22431, 23886, 25247, 26509, 27666, 28714, 29648, 30466,
+  31163, 31738, 32187, 32509, 32702,
+};
+
+static int16_t to_fixed(float sample) {
+  float scaled = sample * TREMOR_FREQ_INPUT_SCALE;
+  if (scaled > INT16_MAX) {
+    return INT16_MAX;
+  } else if (scaled < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)lroundf(scaled);
+}
+
+// mean square contribution of a bin, in input units squared
+//  a sinusoid of amplitude A centered on a bin gives |X| = A*N/2 and mean
+//  square A^2/2, so mean square = 2*|X|^2/N^2
+static float bin_power(const tremor_freq_t* tracker, int bin) {
+  float re = tracker->real[bin];
+  float im = tracker->imag[bin];
+  float scale = (float)TREMOR_FREQ_WINDOW * TREMOR_FREQ_INPUT_SCALE;
+  return 2.0f * (re * re + im * im) / (scale * scale);
+}
+
+void tremor_freq_init(tremor_freq_t* tracker, float sample_rate_hz, float low_hz, float high_hz) {
+  memset(tracker, 0, sizeof(tremor_freq_t));
+  tracker->sample_rate_hz = sample_rate_hz;
+
+  float resolution = sample_rate_hz / TREMOR_FREQ_WINDOW;
+  int first = (int)ceilf(low_hz / resolution);
+  int last = (int)floorf(high_hz / resolution);
+  if (first < 1) {
+    first = 1;
+  }
+  if (last > TREMOR_FREQ_WINDOW / 2) {
+    last = TREMOR_FREQ_WINDOW / 2;
+  }
+  if (last - first + 1 > TREMOR_FREQ_MAX_BINS) {
+    last = first + TREMOR_FREQ_MAX_BINS - 1;
+  }
+  tracker->first_bin = first;
+  tracker->bin_count = (last >= first) ? (last - first + 1) : 0;
+}
+
+void tremor_freq_update(tremor_freq_t* tracker, float sample) {
+  int32_t x = to_fixed(sample);
+  int32_t old = tracker->history[tracker->index];
+  tracker->history[tracker->index] = x;
+
+  // products are shifted back to input scale before accumulating, so a full
+  // window of samples fits easily in 32 bits. The outgoing sample is removed
+  // with the exact term it was added with.
+  for (int i = 0; i < tracker->bin_count; i++) {
+    uint16_t phase = tracker->phase[i];
+    int32_t c = SINE_TABLE[phase + TREMOR_FREQ_WINDOW / 4];
+    int32_t s = SINE_TABLE[phase];
+    tracker->real[i] += ((x * c) >> 15) - ((old * c) >> 15);
+    tracker->imag[i] -= ((x * s) >> 15) - ((old * s) >> 15);
+
+    phase += tracker->first_bin + i;
+    if (phase >= TREMOR_FREQ_WINDOW) {
+      phase -= TREMOR_FREQ_WINDOW;
+    }
+    tracker->phase[i] = phase;
+  }
+
+  tracker->index++;
+  if (tracker->index >= TREMOR_FREQ_WINDOW) {
+    tracker->index = 0;
+  }
+  if (tracker->count < TREMOR_FREQ_WINDOW) {
+    tracker->count++;
+  }
+}
+
+bool tremor_freq_ready(const tremor_freq_t* tracker) {
+  return tracker->count >= TREMOR_FREQ_WINDOW;
+}
+
+tremor_freq_result_t tremor_freq_result(const tremor_freq_t* tracker) {
+  tremor_freq_result_t result = {0};
+  if (tracker->bin_count == 0) {
+    return result;
+  }
+
+  int peak = 0;
+  for (int i = 0; i < tracker->bin_count; i++) {
+    float power = bin_power(tracker, i);
+    result.band_power += power;
+    if (power > result.peak_power) {
+      result.peak_power = power;
+      peak = i;
+    }
+  }
+
+  // parabolic interpolation on log power between neighbouring bins
+  float offset = 0.0f;
+  if (peak > 0 && peak < tracker->bin_count - 1 && result.peak_power > 0.0f) {
+    float left = bin_power(tracker, peak - 1);
+    float right = bin_power(tracker, peak + 1);
+    if (left > 0.0f && right > 0.0f) {
+      float l = logf(left);
+      float c = logf(result.peak_power);
+      float r = logf(right);
+      float denom = l - 2.0f * c + r;
+      if (denom < 0.0f) {
+        offset = 0.5f * (l - r) / denom;
+      }
+    }
+  }
+
+  float resolution = tracker->sample_rate_hz / TREMOR_FREQ_WINDOW;
+  result.peak_hz = (tracker->first_bin + peak + offset) * resolution;
+  return result;
+}
@@ -0,0 +1,73 @@
+// Sliding DFT tremor frequency tracker
+//
+// Tracks the spectrum of a motion signal (e.g. gyro rate) over the tremor band
+// with a fixed-point sliding DFT. Each sample updates every bin in the band,
+// so cost is O(bins) per sample and the peak frequency and band power are
+// available on every tick.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Configuration
+
+// DFT window length in samples; frequency resolution is sample rate / window
+// The twiddle table in tremor_freq.c is generated for this length
+#ifndef TREMOR_FREQ_WINDOW
+#define TREMOR_FREQ_WINDOW 100
+#endif
+
+// maximum number of bins tracked in the band
+#ifndef TREMOR_FREQ_MAX_BINS
+#define TREMOR_FREQ_MAX_BINS 32
+#endif
+
+// fixed-point input scale, in LSBs per input unit
+//  16 LSB per degree/second covers the full +/-2000 dps gyro range in int16
+#ifndef TREMOR_FREQ_INPUT_SCALE
+#define TREMOR_FREQ_INPUT_SCALE 16
+#endif
+
+// Types
+
+typedef struct {
+  int16_t history[TREMOR_FREQ_WINDOW];  // last window of samples, fixed point
+  int32_t real[TREMOR_FREQ_MAX_BINS];   // running DFT bins
+  int32_t imag[TREMOR_FREQ_MAX_BINS];
+  uint16_t phase[TREMOR_FREQ_MAX_BINS]; // twiddle index of the next sample per bin
+  uint16_t index;                       // position of the next sample in history
+  uint16_t count;                       // samples seen, saturates at the window
+  uint16_t first_bin;                   // DFT bin of real[0]
+  uint16_t bin_count;
+  float sample_rate_hz;
+} tremor_freq_t;
+
+typedef struct {
+  float peak_hz;     // interpolated frequency of the strongest bin
+  float peak_power;  // mean square of the strongest bin, input units squared
+  float band_power;  // mean square over the whole band, input units squared
+} tremor_freq_result_t;
+
+
+// Function prototypes
+
+// Initialize a tracker
+//
+// tracker - state to initialize, owned by the caller
+// sample_rate_hz - rate tremor_freq_update is called at
+// low_hz, high_hz - band to track, clamped to TREMOR_FREQ_MAX_BINS bins
+void tremor_freq_init(tremor_freq_t* tracker, float sample_rate_hz, float low_hz, float high_hz);
+
+// Process one sample
+//
+// O(bins), integer only
+void tremor_freq_update(tremor_freq_t* tracker, float sample);
+
+// Return true once a full window has been processed
+bool tremor_freq_ready(const tremor_freq_t* tracker);
+
+// Compute peak frequency and band power from the current bins
+//
+// O(bins)
+tremor_freq_result_t tremor_freq_result(const tremor_freq_t* tracker);
@@ -0,0 +1,415 @@
+// Virtual timer implementation
+//
+// Hardware independent: the counter and compare interrupt are provided by a
+// backend implementing virtual_timer_hal.h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "virtual_timer.h"
+#include "virtual_timer_hal.h"
+#include "virtual_timer_heap.h"
+#include "virtual_timer_stats.h"
+
+// Statically allocated timer nodes
+// Timer IDs encode the pool index in the low half and the node's generation
+// in the high half, so an ID that outlives its timer is detected as stale
+static node_t node_pool[VIRTUAL_TIMER_MAX_TIMERS];
+static uint16_t free_stack[VIRTUAL_TIMER_MAX_TIMERS];
+static uint16_t free_count = 0;
+
+// Take a node from the pool. O(1)
+// Must be called with interrupts disabled
+static node_t* pool_alloc(void) {
+  if (free_count == 0) {
+    return NULL;
+  }
+  node_t* node = &node_pool[free_stack[--free_count]];
+  node->in_use = true;
+  return node;
+}
+
+// Return a node to the pool, invalidating any outstanding IDs for it. O(1)
+// Must be called with interrupts disabled
+static void pool_release(node_t* node) {
+  node->in_use = false;
+  node->generation++;
+  free_stack[free_count++] = node - node_pool;
+}
+
+static uint32_t pool_id(node_t* node) {
+  // index is offset by one so that 0 is never a valid ID
+  return ((uint32_t)node->generation << 16) | (uint32_t)(node - node_pool + 1);
+}
+
+// Look up a live node by ID, returning NULL for stale or invalid IDs
+// Must be called with interrupts disabled
+static node_t* pool_lookup(uint32_t timer_id) {
+  uint32_t index = (timer_id & 0xFFFF);
+  if (index == 0 || index > VIRTUAL_TIMER_MAX_TIMERS) {
+    return NULL;
+  }
+  node_t* node = &node_pool[index - 1];
+  if (!node->in_use || node->generation != (timer_id >> 16)) {
+    return NULL;
+  }
+  return node;
+}
+
+// Expired deferred timers waiting for virtual_timer_dispatch()
+// Single producer (TIMER4 interrupt), single consumer (main loop), so the
+// head is only written by the interrupt and the tail only by the consumer
+typedef struct {
+  uint32_t timer_id;
+  uint32_t deadline;
+} deferred_entry_t;
+
+static deferred_entry_t deferred_queue[VIRTUAL_TIMER_QUEUE_SIZE];
+static volatile uint32_t deferred_head = 0;
+static volatile uint32_t deferred_tail = 0;
+static volatile uint32_t deferred_overruns = 0;
+
+// Push an expired timer ID, returns false if the queue is full
+static bool deferred_push(uint32_t timer_id, uint32_t deadline) {
+  uint32_t head = deferred_head;
+  if (head - deferred_tail >= VIRTUAL_TIMER_QUEUE_SIZE) {
+    deferred_overruns++;
+    return false;
+  }
+  deferred_queue[head % VIRTUAL_TIMER_QUEUE_SIZE].timer_id = timer_id;
+  deferred_queue[head % VIRTUAL_TIMER_QUEUE_SIZE].deadline = deadline;
+  // make sure the entry is written before it is published
+  virtual_timer_hal_memory_barrier();
+  deferred_head = head + 1;
+  return true;
+}
+
+// Number of compare interrupts handled
+static volatile uint32_t wakeup_count = 0;
+
+// Idle accounting since the last call to virtual_timer_idle_stats()
+static uint32_t idle_window_start = 0;
+static uint32_t idle_us = 0;
+static uint32_t idle_wakeups = 0;
+
+#if VIRTUAL_TIMER_STATS_ENABLED
+// time from scheduled deadline to callback start, and callback run time
+static timer_histogram_t lateness_hist;
+static timer_histogram_t runtime_hist;
+
+// Run a callback, recording how late it started and how long it took
+// Must be called with the deadline the callback was scheduled for
+static void run_callback(virtual_timer_callback_t cb, uint32_t deadline) {
+  uint32_t start = read_timer();
+  cb();
+  uint32_t end = read_timer();
+
+  virtual_timer_hal_critical_enter();
+  timer_histogram_add(&lateness_hist, start - deadline);
+  timer_histogram_add(&runtime_hist, end - start);
+  virtual_timer_hal_critical_exit();
+}
+#else
+#define run_callback(cb, deadline) ((void)(deadline), (cb)())
+#endif
+
+// Upper 32 bits of the extended timebase
+// Incremented every time the counter wraps
+static volatile uint32_t timer_high = 0;
+
+void virtual_timer_wrap_handler(void) {
+  timer_high++;
+}
+
+// Point the compare at the first deadline
+// If that deadline is already due (it was inserted very close to now, or the
+// head was removed), the compare would not fire until the counter wraps, so
+// request the handler directly instead
+// Must be called with interrupts disabled
+static void arm_compare(void) {
+  node_t* first = heap_get_first();
+  if (first == NULL) {
+    return;
+  }
+  virtual_timer_hal_set_compare(first->timer_value);
+  if (!timer_before(read_timer(), first->timer_value)) {
+    virtual_timer_hal_trigger();
+  }
+}
+
+// Called from the backend's interrupt when the counter reaches the deadline
+// of the first timer
+//
+// Timers are ordered by their latest allowed expiration (timer_value). Once
+// the handler runs, every timer at the front of the heap whose slack window
+// has opened is fired too, so timers with overlapping windows share one
+// interrupt
+void virtual_timer_compare_handler(void) {
+  wakeup_count++;
+
+  node_t* temp = heap_get_first();
+  while (temp != NULL && !timer_before(read_timer(), temp->timer_value - temp->slack)) {
+    // requeue or release the node before running the callback, so the
+    // callback is free to cancel or start timers itself
+    virtual_timer_callback_t cb = temp->cb;
+    bool deferred = temp->deferred;
+    uint32_t timer_id = pool_id(temp);
+    uint32_t deadline = temp->timer_value - temp->slack;
+    heap_remove_first();
+
+    if (temp->repeated) {
+      // advance from the previous deadline, not from now, so interrupt
+      // latency never accumulates. If we fell more than a period behind,
+      // skip the missed periods but stay on the original phase
+      uint32_t now = read_timer();
+      do {
+        temp->timer_value += temp->incr;
+      } while (!timer_before(now, temp->timer_value));
+      heap_insert(temp);
+    } else if (!deferred) {
+      pool_release(temp);
+    }
+
+    if (deferred) {
+      // deferred one-shot nodes are released by the dispatcher, so that
+      // cancelling one before it is dispatched still works
+      if (!deferred_push(timer_id, deadline) && !temp->repeated) {
+        pool_release(temp);
+      }
+    } else {
+      run_callback(cb, deadline);
+    }
+
+    if (heap_get_first()) {
+      virtual_timer_hal_set_compare(heap_get_first()->timer_value);
+    }
+    // the loop condition catches any deadline that passed while arming
+    temp = heap_get_first();
+  }
+}
+
+// Read the current value of the timer counter
+uint32_t read_timer(void) {
+  return virtual_timer_hal_now();
+}
+
+// Read the 64-bit extended timer value
+uint64_t read_timer64(void) {
+  virtual_timer_hal_critical_enter();
+  uint32_t low = read_timer();
+  uint32_t high = timer_high;
+  // the wrap may have happened since interrupts were disabled
+  if (virtual_timer_hal_wrap_pending() && low < 0x80000000) {
+    high++;
+  }
+  virtual_timer_hal_critical_exit();
+  return ((uint64_t)high << 32) | low;
+}
+
+// Initialize the backend counter and the timer bookkeeping
+void virtual_timer_init(void) {
+  // every node starts out free
+  for (uint16_t i = 0; i < VIRTUAL_TIMER_MAX_TIMERS; i++) {
+    node_pool[i].in_use = false;
+    free_stack[i] = VIRTUAL_TIMER_MAX_TIMERS - 1 - i;
+  }
+  free_count = VIRTUAL_TIMER_MAX_TIMERS;
+
+#if VIRTUAL_TIMER_STATS_ENABLED
+  timer_histogram_reset(&lateness_hist, VIRTUAL_TIMER_STATS_BUCKET_US);
+  timer_histogram_reset(&runtime_hist, VIRTUAL_TIMER_STATS_BUCKET_US);
+#endif
+
+  timer_high = 0;
+  wakeup_count = 0;
+  virtual_timer_hal_init();
+  idle_window_start = read_timer();
+}
+
+// Start a timer. This function is called for both one-shot and repeated timers
+// Takes a node from the static pool, places it in the heap, and re-arms the
+// compare, all with the timer interrupt disabled so the handler never sees
+// a half-inserted node. Returns 0 if the pool is exhausted or a repeated
+// timer has no period, which would never leave the compare handler
+static uint32_t timer_start(uint32_t microseconds, uint32_t slack_us, virtual_timer_callback_t cb, bool repeated, bool deferred) {
+  if (repeated && microseconds == 0) {
+    return 0;
+  }
+
+  virtual_timer_hal_critical_enter();
+  node_t* timer_node = pool_alloc();
+  if (timer_node == NULL) {
+    // too many timers armed
+    virtual_timer_hal_critical_exit();
+    return 0;
+  }
+  timer_node->timer_value = microseconds + slack_us + read_timer();
+  timer_node->slack = slack_us;
+  timer_node->cb = cb;
+  timer_node->incr = microseconds;
+  timer_node->repeated = repeated;
+  timer_node->deferred = deferred;
+  heap_insert(timer_node);
+  arm_compare();
+  uint32_t timer_id = pool_id(timer_node);
+  virtual_timer_hal_critical_exit();
+  return timer_id;
+}
+
+uint32_t virtual_timer_start(uint32_t microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, 0, cb, false, false);
+}
+
+uint32_t virtual_timer_start_repeated(uint32_t microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, 0, cb, true, false);
+}
+
+uint32_t virtual_timer_start_deferred(uint32_t microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, 0, cb, false, true);
+}
+
+uint32_t virtual_timer_start_repeated_deferred(uint32_t microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, 0, cb, true, true);
+}
+
+uint32_t virtual_timer_start_slack(uint32_t microseconds, uint32_t slack_us, virtual_timer_callback_t cb, uint32_t flags) {
+  return timer_start(microseconds, slack_us, cb,
+      (flags & VIRTUAL_TIMER_REPEATED) != 0, (flags & VIRTUAL_TIMER_DEFERRED) != 0);
+}
+
+uint32_t virtual_timer_wakeups(void) {
+  return wakeup_count;
+}
+
+// Run the callbacks of deferred timers that have expired
+// Timers cancelled after expiring but before dispatch are skipped
+uint32_t virtual_timer_dispatch(void) {
+  uint32_t count = 0;
+  while (deferred_tail != deferred_head) {
+    uint32_t tail = deferred_tail;
+    uint32_t timer_id = deferred_queue[tail % VIRTUAL_TIMER_QUEUE_SIZE].timer_id;
+    uint32_t deadline = deferred_queue[tail % VIRTUAL_TIMER_QUEUE_SIZE].deadline;
+    deferred_tail = tail + 1;
+
+    virtual_timer_hal_critical_enter();
+    node_t* node = pool_lookup(timer_id);
+    virtual_timer_callback_t cb = NULL;
+    if (node != NULL) {
+      cb = node->cb;
+      if (!node->repeated) {
+        pool_release(node);
+      }
+    }
+    virtual_timer_hal_critical_exit();
+
+    if (cb != NULL) {
+      run_callback(cb, deadline);
+      count++;
+    }
+  }
+  return count;
+}
+
+uint32_t virtual_timer_overruns(void) {
+  return deferred_overruns;
+}
+
+// Sleep until the next interrupt if no deferred callbacks are waiting
+// The next timer deadline is always armed on the compare, so this sleeps at most
+// until the next timer expires
+void virtual_timer_idle(void) {
+  if (deferred_tail != deferred_head) {
+    return;
+  }
+
+  uint32_t sleep_start = read_timer();
+  virtual_timer_hal_sleep();
+  uint32_t sleep_end = read_timer();
+
+  idle_us += sleep_end - sleep_start;
+  idle_wakeups++;
+}
+
+void virtual_timer_idle_stats(uint32_t* idle_percent, uint32_t* wakeups_per_second) {
+  uint32_t now = read_timer();
+  uint32_t elapsed = now - idle_window_start;
+
+  if (elapsed == 0) {
+    *idle_percent = 0;
+    *wakeups_per_second = 0;
+  } else {
+    *idle_percent = ((uint64_t)idle_us * 100) / elapsed;
+    *wakeups_per_second = ((uint64_t)idle_wakeups * 1000000) / elapsed;
+  }
+
+  // start a new window
+  idle_window_start = now;
+  idle_us = 0;
+  idle_wakeups = 0;
+}
+
+#if VIRTUAL_TIMER_STATS_ENABLED
+void virtual_timer_stats_get(timer_histogram_t* lateness, timer_histogram_t* runtime) {
+  virtual_timer_hal_critical_enter();
+  *lateness = lateness_hist;
+  *runtime = runtime_hist;
+  virtual_timer_hal_critical_exit();
+}
+
+void virtual_timer_stats_reset(void) {
+  virtual_timer_hal_critical_enter();
+  timer_histogram_reset(&lateness_hist, VIRTUAL_TIMER_STATS_BUCKET_US);
+  timer_histogram_reset(&runtime_hist, VIRTUAL_TIMER_STATS_BUCKET_US);
+  virtual_timer_hal_critical_exit();
+}
+
+void virtual_timer_stats_print(void) {
+  // copy out so printing does not hold off timer interrupts
+  timer_histogram_t lateness;
+  timer_histogram_t runtime;
+  virtual_timer_stats_get(&lateness, &runtime);
+  timer_histogram_print("Timer lateness", &lateness);
+  timer_histogram_print("Callback time", &runtime);
+  printf("Deferred overruns: %" PRIu32 "\n", deferred_overruns);
+}
+#endif
+
+// Remove a timer by ID.
+// The ID resolves to its node directly, so no searching is needed.
+// Stale IDs (timers that already expired or were cancelled) are ignored.
+void virtual_timer_cancel(uint32_t timer_id) {
+  virtual_timer_hal_critical_enter();
+  node_t* node = pool_lookup(timer_id);
+  if (node != NULL) {
+    bool was_first = (heap_get_first() == node);
+    heap_remove(node);
+    pool_release(node);
+    if (was_first) {
+      arm_compare();
+    }
+  }
+  virtual_timer_hal_critical_exit();
+}
+
+// Move a timer's next expiration to <microseconds> from now
+// Repeated timers also take <microseconds> as their new period
+bool virtual_timer_reschedule(uint32_t timer_id, uint32_t microseconds) {
+  virtual_timer_hal_critical_enter();
+  node_t* node = pool_lookup(timer_id);
+  // a deferred one-shot that expired but was not dispatched yet is still
+  // allocated, but it is no longer armed and cannot be moved
+  // a repeated timer with no period would never leave the compare handler
+  if (node == NULL || !heap_contains(node) || (node->repeated && microseconds == 0)) {
+    virtual_timer_hal_critical_exit();
+    return false;
+  }
+  heap_remove(node);
+  node->timer_value = read_timer() + microseconds + node->slack;
+  node->incr = microseconds;
+  heap_insert(node);
+  arm_compare();
+  virtual_timer_hal_critical_exit();
+  return true;
+}
@@ -0,0 +1,109 @@
+// Virtual timer library
+//
+// Multiplexes any number of one-shot and repeated software timers onto one
+// hardware counter. See virtual_timer_hal.h for the hardware backends.
+// Timers are started, cancelled, and rescheduled from the main loop or from
+// timer callbacks; other interrupts may only read the counter.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "virtual_timer_stats.h"
+
+// Number of expired deferred timers that can wait for dispatch
+// Must be a power of two
+#ifndef VIRTUAL_TIMER_QUEUE_SIZE
+#define VIRTUAL_TIMER_QUEUE_SIZE 16
+#endif
+
+// Flags for virtual_timer_start_slack
+#define VIRTUAL_TIMER_REPEATED 0x1
+#define VIRTUAL_TIMER_DEFERRED 0x2
+
+// Type for the function pointer to call when the timer expires
+typedef void (*virtual_timer_callback_t)(void);
+
+// Read the current value of the hardware timer counter
+// Returns the counter value
+uint32_t read_timer(void);
+
+// Read the hardware counter extended to 64 bits
+// Returns microseconds since virtual_timer_init(), never wraps in practice
+uint64_t read_timer64(void);
+
+// Initialize the timer peripheral
+void virtual_timer_init(void);
+
+// Start a one-shot timer that calls <cb> <microseconds> in the future
+// Returns a unique timer_id, or 0 if VIRTUAL_TIMER_MAX_TIMERS are armed
+uint32_t virtual_timer_start(uint32_t microseconds, virtual_timer_callback_t cb);
+
+// Start timer that repeatedly calls <cb> every <microseconds>
+// Deadlines advance by exact multiples of the period, so the timer does not
+// drift. Durations must be shorter than 2^31 microseconds (about 35 minutes)
+// Returns a unique timer_id, or 0 if VIRTUAL_TIMER_MAX_TIMERS are armed or
+// <microseconds> is 0
+uint32_t virtual_timer_start_repeated(uint32_t microseconds, virtual_timer_callback_t cb);
+
+// Same as virtual_timer_start, but <cb> runs from virtual_timer_dispatch()
+// instead of interrupt context
+uint32_t virtual_timer_start_deferred(uint32_t microseconds, virtual_timer_callback_t cb);
+
+// Same as virtual_timer_start_repeated, but <cb> runs from
+// virtual_timer_dispatch() instead of interrupt context
+uint32_t virtual_timer_start_repeated_deferred(uint32_t microseconds, virtual_timer_callback_t cb);
+
+// Start a timer that may fire anywhere from <microseconds> to
+// <microseconds> + <slack_us> in the future. Timers whose windows overlap
+// are fired from a single interrupt, reducing wakeups
+// flags - VIRTUAL_TIMER_REPEATED and/or VIRTUAL_TIMER_DEFERRED
+// Returns a unique timer_id, or 0 if VIRTUAL_TIMER_MAX_TIMERS are armed or
+// a repeated timer has a <microseconds> of 0
+uint32_t virtual_timer_start_slack(uint32_t microseconds, uint32_t slack_us, virtual_timer_callback_t cb, uint32_t flags);
+
+// Returns the number of timer interrupts handled since init
+uint32_t virtual_timer_wakeups(void);
+
+// Run callbacks for deferred timers that have expired
+// Call from the main loop or an app_scheduler event, never from an interrupt
+// Returns the number of callbacks run
+uint32_t virtual_timer_dispatch(void);
+
+// Returns the number of deferred expirations dropped because the queue was full
+uint32_t virtual_timer_overruns(void);
+
+// Idle hook for the main loop
+// Enters low-power sleep through the backend (nrf_pwr_mgmt_run on the nRF52)
+// until the next interrupt, which
+// is at the latest the next timer deadline. Returns immediately if deferred
+// callbacks are waiting, so call virtual_timer_dispatch() after it returns.
+// On the nRF52, nrf_pwr_mgmt_init() must have been called
+void virtual_timer_idle(void);
+
+// Report the share of time spent asleep in virtual_timer_idle() and how often
+// the core woke up, measured since the previous call (or init)
+void virtual_timer_idle_stats(uint32_t* idle_percent, uint32_t* wakeups_per_second);
+
+// Takes a timer_id and cancels that timer such that it stops firing
+// IDs of timers that already expired or were cancelled are ignored
+void virtual_timer_cancel(uint32_t timer_id);
+
+// Move a timer's next expiration to <microseconds> from now without
+// cancelling and restarting it. Repeated timers keep this as their period
+// Returns false if the timer already expired or was cancelled, or if it is
+// a repeated timer and <microseconds> is 0. The timer is unchanged then
+bool virtual_timer_reschedule(uint32_t timer_id, uint32_t microseconds);
+
+#if VIRTUAL_TIMER_STATS_ENABLED
+// Copy the histograms of callback lateness (actual start minus scheduled
+// deadline) and callback execution time, both in microseconds
+void virtual_timer_stats_get(timer_histogram_t* lateness, timer_histogram_t* runtime);
+
+// Clear the lateness and execution time histograms
+void virtual_timer_stats_reset(void);
+
+// Print the lateness and execution time histograms over RTT
+void virtual_timer_stats_print(void);
+#endif
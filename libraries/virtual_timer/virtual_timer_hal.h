@@ -0,0 +1,59 @@
+// Counter/compare hardware abstraction for the virtual timer library
+//
+// The scheduling logic in virtual_timer.c only talks to the hardware through
+// these functions. Two backends are provided:
+//  - virtual_timer_hal_nrf52.c drives TIMER4 on the nRF52 (the default)
+//  - virtual_timer_hal_sim.c is a simulated clock that builds on a host when
+//    VIRTUAL_TIMER_HAL_SIM is defined, e.g.
+//      gcc -DVIRTUAL_TIMER_HAL_SIM -Ilibraries/virtual_timer libraries/virtual_timer/*.c ...
+//
+// The counter is a free-running 32-bit microsecond counter. A backend calls
+// virtual_timer_compare_handler() when the counter reaches the compare value
+// and virtual_timer_wrap_handler() when the counter wraps to zero, both from
+// the timer's interrupt context.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -- Backend functions
+
+// Reset the counter to zero, start it, and enable compare and wrap interrupts
+void virtual_timer_hal_init(void);
+
+// Return the current counter value in microseconds
+uint32_t virtual_timer_hal_now(void);
+
+// Arm the compare interrupt for the given counter value
+void virtual_timer_hal_set_compare(uint32_t deadline);
+
+// Run virtual_timer_compare_handler() from the timer interrupt as soon as
+// interrupts are enabled, regardless of the compare value. Used when a
+// deadline is already due by the time it is armed
+void virtual_timer_hal_trigger(void);
+
+// Return true if a counter wrap has happened but its interrupt has not yet
+// been handled. Used to extend the counter to 64 bits without tearing
+bool virtual_timer_hal_wrap_pending(void);
+
+// Disable and re-enable the timer interrupt around shared state
+// Calls may nest; the timer interrupt is restored by the outermost exit
+// Other interrupts stay enabled, so they must not start, cancel, or
+// reschedule timers; reading the counter is safe from anywhere
+void virtual_timer_hal_critical_enter(void);
+void virtual_timer_hal_critical_exit(void);
+
+// Make prior memory writes visible before a following write is observed
+void virtual_timer_hal_memory_barrier(void);
+
+// Sleep until the next interrupt
+void virtual_timer_hal_sleep(void);
+
+// -- Handlers provided by virtual_timer.c
+
+// Counter reached the armed compare value
+void virtual_timer_compare_handler(void);
+
+// Counter wrapped to zero
+void virtual_timer_wrap_handler(void);
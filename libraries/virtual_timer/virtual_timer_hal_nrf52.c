@@ -0,0 +1,108 @@
+// nRF52 TIMER4 backend for the virtual timer library
+//
+// TIMER4 runs as a 32-bit, 1 MHz free-running counter
+//  - CC[0] is the next timer deadline
+//  - CC[1] is used to capture the current count
+//  - CC[3] is fixed at 0 and marks counter wrap
+//
+// Board.mk builds every library into every app, so this file defines
+// TIMER4_IRQHandler in all of them. TIMER4 belongs to the virtual timer and
+// must not also be enabled for the nrfx timer driver
+
+#ifndef VIRTUAL_TIMER_HAL_SIM
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrfx.h"
+
+#include "virtual_timer_hal.h"
+
+#if NRFX_CHECK(NRFX_TIMER4_ENABLED)
+#error "TIMER4 is used by the virtual timer, disable NRFX_TIMER4_ENABLED"
+#endif
+
+// set when the compare handler was requested by software
+static volatile bool compare_triggered = false;
+
+// critical section nesting
+static volatile uint32_t critical_depth = 0;
+
+// This is the interrupt handler that fires on a compare event
+void TIMER4_IRQHandler(void) {
+  // counter wrapped
+  if (NRF_TIMER4->EVENTS_COMPARE[3]) {
+    NRF_TIMER4->EVENTS_COMPARE[3] = 0;
+    virtual_timer_wrap_handler();
+  }
+
+  if (NRF_TIMER4->EVENTS_COMPARE[0] || compare_triggered) {
+    // It clears the event so that it doesn't happen again
+    NRF_TIMER4->EVENTS_COMPARE[0] = 0;
+    compare_triggered = false;
+    virtual_timer_compare_handler();
+  }
+}
+
+// Initialize TIMER4 as a free running 32-bit, 1 MHz counter with the
+// compare (CC[0]) and wrap (CC[3]) interrupts enabled
+void virtual_timer_hal_init(void) {
+  NRF_TIMER4->PRESCALER = 0x4;
+  NRF_TIMER4->BITMODE = 0x3;
+  NRF_TIMER4->TASKS_CLEAR = 1;
+
+  // CC[3] marks counter wrap for the extended timebase
+  NRF_TIMER4->CC[3] = 0;
+  NRF_TIMER4->EVENTS_COMPARE[3] = 0;
+
+  NRF_TIMER4->INTENSET |= (1 << 16) | (1 << 19);
+  NVIC_EnableIRQ(TIMER4_IRQn);
+
+  NRF_TIMER4->TASKS_START = 1;
+}
+
+// Read the current value of the timer counter
+uint32_t virtual_timer_hal_now(void) {
+  NRF_TIMER4->TASKS_CAPTURE[1] = 1;
+  return NRF_TIMER4->CC[1];
+}
+
+void virtual_timer_hal_set_compare(uint32_t deadline) {
+  NRF_TIMER4->CC[0] = deadline;
+}
+
+void virtual_timer_hal_trigger(void) {
+  compare_triggered = true;
+  NVIC_SetPendingIRQ(TIMER4_IRQn);
+}
+
+bool virtual_timer_hal_wrap_pending(void) {
+  return NRF_TIMER4->EVENTS_COMPARE[3] != 0;
+}
+
+// Only TIMER4 is masked, so PWM, GPIOTE, and the SoftDevice keep running
+// NVIC_DisableIRQ ends with a barrier, so the handler cannot start once it
+// returns. Other interrupts may nest sections of their own, which always
+// leave the depth as they found it
+void virtual_timer_hal_critical_enter(void) {
+  NVIC_DisableIRQ(TIMER4_IRQn);
+  critical_depth++;
+}
+
+void virtual_timer_hal_critical_exit(void) {
+  if (--critical_depth == 0) {
+    NVIC_EnableIRQ(TIMER4_IRQn);
+  }
+}
+
+void virtual_timer_hal_memory_barrier(void) {
+  __DMB();
+}
+
+void virtual_timer_hal_sleep(void) {
+  nrf_pwr_mgmt_run();
+}
+
+#endif
@@ -0,0 +1,164 @@
+// Simulated-clock backend for the virtual timer library
+//
+// Builds on a host when VIRTUAL_TIMER_HAL_SIM is defined. Time only moves
+// when the program calls virtual_timer_sim_advance(), which fires the
+// compare and wrap handlers exactly as the hardware would, so scheduling
+// behaviour is deterministic and can be exercised off-target.
+
+#ifdef VIRTUAL_TIMER_HAL_SIM
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "virtual_timer_hal.h"
+#include "virtual_timer_hal_sim.h"
+
+static uint32_t sim_now = 0;
+static uint32_t sim_compare = 0;
+static bool sim_compare_armed = false;
+static bool sim_in_handler = false;
+static bool sim_triggered = false;
+static uint32_t sim_critical_depth = 0;
+
+// reports host time spent with the timer interrupt held off, when set
+static virtual_timer_sim_section_t sim_section_cb = NULL;
+static uint64_t sim_critical_start = 0;
+
+static uint64_t host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sim_section_end(uint64_t start) {
+  uint64_t elapsed = host_ns() - start;
+  sim_section_cb((elapsed > UINT32_MAX) ? UINT32_MAX : elapsed);
+}
+
+// run the handlers as the timer interrupt would, timing the run
+static void sim_run_compare(void) {
+  uint64_t start = sim_section_cb ? host_ns() : 0;
+  virtual_timer_compare_handler();
+  if (sim_section_cb) {
+    sim_section_end(start);
+  }
+}
+
+static void sim_run_wrap(void) {
+  uint64_t start = sim_section_cb ? host_ns() : 0;
+  virtual_timer_wrap_handler();
+  if (sim_section_cb) {
+    sim_section_end(start);
+  }
+}
+
+// run a requested compare handler, as the pended interrupt would on hardware
+static void sim_run_triggered(void) {
+  if (sim_triggered && !sim_in_handler && sim_critical_depth == 0) {
+    sim_triggered = false;
+    sim_in_handler = true;
+    sim_run_compare();
+    sim_in_handler = false;
+  }
+}
+
+void virtual_timer_hal_init(void) {
+  sim_now = 0;
+  sim_compare = 0;
+  sim_compare_armed = false;
+  sim_triggered = false;
+  sim_critical_depth = 0;
+}
+
+uint32_t virtual_timer_hal_now(void) {
+  return sim_now;
+}
+
+void virtual_timer_hal_set_compare(uint32_t deadline) {
+  sim_compare = deadline;
+  sim_compare_armed = true;
+}
+
+void virtual_timer_hal_trigger(void) {
+  sim_triggered = true;
+  sim_run_triggered();
+}
+
+bool virtual_timer_hal_wrap_pending(void) {
+  // wraps are always delivered synchronously in virtual_timer_sim_advance
+  return false;
+}
+
+void virtual_timer_hal_critical_enter(void) {
+  // single threaded, only track nesting so triggered handlers wait for the
+  // outermost exit like a pended interrupt would
+  if (sim_critical_depth == 0 && sim_section_cb && !sim_in_handler) {
+    sim_critical_start = host_ns();
+  }
+  sim_critical_depth++;
+}
+
+void virtual_timer_hal_critical_exit(void) {
+  sim_critical_depth--;
+  if (sim_critical_depth == 0 && sim_section_cb && !sim_in_handler) {
+    sim_section_end(sim_critical_start);
+  }
+  sim_run_triggered();
+}
+
+void virtual_timer_hal_memory_barrier(void) {
+}
+
+void virtual_timer_hal_sleep(void) {
+  // jump straight to the armed deadline, like a core sleeping until the
+  // compare interrupt
+  if (sim_compare_armed) {
+    virtual_timer_sim_advance(sim_compare - sim_now);
+  }
+}
+
+void virtual_timer_sim_set_time(uint32_t now) {
+  sim_now = now;
+}
+
+void virtual_timer_sim_time_sections(virtual_timer_sim_section_t cb) {
+  sim_section_cb = cb;
+}
+
+void virtual_timer_sim_advance(uint32_t microseconds) {
+  // step to each event inside the interval so handlers see the counter value
+  // they would on hardware. Handlers may re-arm the compare as we go
+  while (microseconds > 0) {
+    uint32_t step = microseconds;
+
+    uint32_t to_wrap = 0 - sim_now;
+    if (to_wrap != 0 && to_wrap < step) {
+      step = to_wrap;
+    }
+
+    uint32_t to_compare = sim_compare - sim_now;
+    if (sim_compare_armed && to_compare != 0 && to_compare < step) {
+      step = to_compare;
+    }
+
+    sim_now += step;
+    microseconds -= step;
+
+    if (sim_in_handler) {
+      continue;
+    }
+    sim_in_handler = true;
+    if (sim_now == 0) {
+      sim_run_wrap();
+    }
+    if (sim_compare_armed && sim_now == sim_compare) {
+      sim_run_compare();
+    }
+    sim_in_handler = false;
+    sim_run_triggered();
+  }
+}
+
+#endif
@@ -0,0 +1,25 @@
+// Controls for the simulated-clock virtual timer backend
+//
+// Only available when built with VIRTUAL_TIMER_HAL_SIM
+
+#pragma once
+
+#include <stdint.h>
+
+// Set the simulated counter without firing any handlers
+//  Useful to start a run just before the 32-bit counter wraps
+void virtual_timer_sim_set_time(uint32_t now);
+
+// Move simulated time forward, firing the compare and wrap handlers at the
+//  exact counter values they would fire at on hardware
+void virtual_timer_sim_advance(uint32_t microseconds);
+
+// Called with the host time of each stretch the timer interrupt is held off
+typedef void (*virtual_timer_sim_section_t)(uint32_t nanoseconds);
+
+// Time, on the host clock, every outermost critical section and every run
+//  of the compare or wrap handler, which holds the interrupt off on hardware
+//  by running in it, and report each to cb. Sections inside a handler are
+//  part of its run. NULL, the default, stops timing, since reading the
+//  clock lengthens every section
+void virtual_timer_sim_time_sections(virtual_timer_sim_section_t cb);
@@ -0,0 +1,138 @@
+// Binary min-heap implementation for virtual timers
+//
+// Fixed-capacity and array backed. The node with the smallest `timer_value`
+// is always at index 0, and each node records its own index so it can be
+// removed without searching.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "virtual_timer_heap.h"
+
+// the heap
+static node_t* heap[VIRTUAL_TIMER_MAX_TIMERS];
+static uint16_t heap_count = 0;
+
+
+// -- Internal functions
+
+static void heap_place(node_t* node, uint16_t index) {
+    heap[index] = node;
+    node->heap_index = index;
+}
+
+// move the node at index towards the root until its parent is not later
+static void heap_sift_up(uint16_t index) {
+    node_t* node = heap[index];
+    while (index > 0) {
+        uint16_t parent = (index - 1) / 2;
+        if (!timer_before(node->timer_value, heap[parent]->timer_value)) {
+            break;
+        }
+        heap_place(heap[parent], index);
+        index = parent;
+    }
+    heap_place(node, index);
+}
+
+// move the node at index towards the leaves until no child is earlier
+static void heap_sift_down(uint16_t index) {
+    node_t* node = heap[index];
+    while (true) {
+        uint16_t child = 2 * index + 1;
+        if (child >= heap_count) {
+            break;
+        }
+        if (child + 1 < heap_count && timer_before(heap[child + 1]->timer_value, heap[child]->timer_value)) {
+            child++;
+        }
+        if (!timer_before(heap[child]->timer_value, node->timer_value)) {
+            break;
+        }
+        heap_place(heap[child], index);
+        index = child;
+    }
+    heap_place(node, index);
+}
+
+static void heap_remove_at(uint16_t index) {
+    heap_count--;
+    if (index == heap_count) {
+        return;
+    }
+
+    // fill the hole with the last node and restore ordering in whichever
+    //  direction it is violated
+    heap_place(heap[heap_count], index);
+    if (index > 0 && timer_before(heap[index]->timer_value, heap[(index - 1) / 2]->timer_value)) {
+        heap_sift_up(index);
+    } else {
+        heap_sift_down(index);
+    }
+}
+
+
+// -- External functions
+
+// insert item into heap ordered by `timer_value`
+bool heap_insert(node_t* node) {
+
+    if (node == NULL || heap_count >= VIRTUAL_TIMER_MAX_TIMERS) {
+        return false;
+    }
+
+    heap_place(node, heap_count);
+    heap_count++;
+    heap_sift_up(node->heap_index);
+    return true;
+}
+
+// return first element without removing
+node_t* heap_get_first() {
+    if (heap_count == 0) {
+        return NULL;
+    }
+    return heap[0];
+}
+
+// remove and return first element
+node_t* heap_remove_first() {
+    if (heap_count == 0) {
+        return NULL;
+    }
+    node_t* head = heap[0];
+    heap_remove_at(0);
+    return head;
+}
+
+// remove an arbitrary node if in heap
+void heap_remove(node_t* node) {
+    // ignore nodes that are not currently in the heap
+    if (heap_contains(node)) {
+        heap_remove_at(node->heap_index);
+    }
+}
+
+bool heap_contains(node_t* node) {
+    return node != NULL && node->heap_index < heap_count && heap[node->heap_index] == node;
+}
+
+uint16_t heap_size() {
+    return heap_count;
+}
+
+// print contents of heap in array order
+void heap_print() {
+    // handle an empty heap
+    if (heap_count == 0) {
+        printf("[ EMPTY ]\n");
+    } else {
+        printf("[ (%" PRIu32 ")", heap[0]->timer_value);
+        for (uint16_t i = 1; i < heap_count; i++) {
+            printf(" (%" PRIu32 ")", heap[i]->timer_value);
+        }
+        printf(" ]\n");
+    }
+}
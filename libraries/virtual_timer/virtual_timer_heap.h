@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "virtual_timer.h"
+
+// Maximum number of timers that may be armed at once
+#ifndef VIRTUAL_TIMER_MAX_TIMERS
+#define VIRTUAL_TIMER_MAX_TIMERS 32
+#endif
+
+// Wrap-safe deadline comparison for the 32-bit counter
+//  True if a is earlier than b. Valid while the two are less than 2^31 us
+//  (about 35 minutes) apart, regardless of where the counter wraps
+static inline bool timer_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+// -- Heap types
+
+// a timer within the heap
+typedef struct node_t {
+
+    // latest allowed expiration in microseconds. Used to order the heap.
+    //  Must be initialized when the node is created
+    uint32_t timer_value;
+
+    // the timer may fire up to this many microseconds before timer_value
+    uint32_t slack;
+
+    // position of this node in the heap array. Maintained by the heap, do not
+    //  change this field or you will break the heap
+    uint16_t heap_index;
+
+    virtual_timer_callback_t cb;
+
+    uint32_t incr;
+    bool repeated;
+
+    // run the callback from virtual_timer_dispatch() instead of the interrupt
+    bool deferred;
+
+    // pool bookkeeping. A node's generation changes every time it is freed
+    //  so that stale timer IDs can be detected
+    uint16_t generation;
+    bool in_use;
+} node_t;
+
+
+// -- Heap functions
+
+// Insert node into the heap based on node->timer_value. O(log n)
+//  Returns false if node is NULL or the heap is already at
+//  VIRTUAL_TIMER_MAX_TIMERS.
+bool heap_insert(node_t* node);
+
+
+// Return the node with the smallest timer_value without removing it. This
+//  value may be NULL if the heap is empty. O(1)
+node_t* heap_get_first();
+
+
+// Remove the node with the smallest timer_value and return it. This value may
+//  be NULL if the heap is empty. O(log n)
+node_t* heap_remove_first();
+
+
+// Remove the specified node from the heap if present. NULL is ignored. Note that the memory
+//  for the node is NOT automatically freed. O(log n)
+void heap_remove(node_t* node);
+
+
+// Return true if the node is currently in the heap. O(1)
+bool heap_contains(node_t* node);
+
+
+// Return the number of nodes in the heap
+uint16_t heap_size();
+
+
+// Print the heap for debugging.
+void heap_print();
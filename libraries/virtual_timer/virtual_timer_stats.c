@@ -0,0 +1,69 @@
+// Fixed-bucket histograms for virtual timer instrumentation
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "virtual_timer_stats.h"
+
+void timer_histogram_reset(timer_histogram_t* hist, uint32_t bucket_us) {
+  memset(hist, 0, sizeof(timer_histogram_t));
+  hist->min = UINT32_MAX;
+  hist->bucket_us = bucket_us;
+}
+
+void timer_histogram_add(timer_histogram_t* hist, uint32_t value_us) {
+  uint32_t bucket = value_us / hist->bucket_us;
+  if (bucket >= VIRTUAL_TIMER_STATS_BUCKETS) {
+    bucket = VIRTUAL_TIMER_STATS_BUCKETS - 1;
+  }
+  hist->buckets[bucket]++;
+  hist->count++;
+  if (value_us < hist->min) {
+    hist->min = value_us;
+  }
+  if (value_us > hist->max) {
+    hist->max = value_us;
+  }
+}
+
+uint32_t timer_histogram_percentile(const timer_histogram_t* hist, uint8_t percentile) {
+  if (hist->count == 0) {
+    return 0;
+  }
+
+  // smallest bucket whose cumulative count reaches the percentile
+  uint32_t target = ((uint64_t)hist->count * percentile + 99) / 100;
+  uint32_t seen = 0;
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_STATS_BUCKETS - 1; i++) {
+    seen += hist->buckets[i];
+    if (seen >= target) {
+      uint32_t upper = (i + 1) * hist->bucket_us - 1;
+      return (upper < hist->max) ? upper : hist->max;
+    }
+  }
+  return hist->max;
+}
+
+void timer_histogram_print(const char* name, const timer_histogram_t* hist) {
+  if (hist->count == 0) {
+    printf("%s: no samples\n", name);
+    return;
+  }
+  printf("%s: n=%" PRIu32 " min=%" PRIu32 " max=%" PRIu32 " p50=%" PRIu32 " p99=%" PRIu32 " (us)\n", name,
+      hist->count, hist->min, hist->max,
+      timer_histogram_percentile(hist, 50),
+      timer_histogram_percentile(hist, 99));
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_STATS_BUCKETS; i++) {
+    if (hist->buckets[i] == 0) {
+      continue;
+    }
+    uint32_t low = i * hist->bucket_us;
+    if (i == VIRTUAL_TIMER_STATS_BUCKETS - 1) {
+      printf("  >=%5" PRIu32 ": %" PRIu32 "\n", low, hist->buckets[i]);
+    } else {
+      printf("  %5" PRIu32 "-%5" PRIu32 ": %" PRIu32 "\n", low, low + hist->bucket_us - 1, hist->buckets[i]);
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// Timer latency and jitter instrumentation
+//
+// Enable by defining VIRTUAL_TIMER_STATS_ENABLED to 1 (for example with
+// -DVIRTUAL_TIMER_STATS_ENABLED=1 in the app Makefile). When disabled, the
+// timer library contains no instrumentation code at all.
+
+#ifndef VIRTUAL_TIMER_STATS_ENABLED
+#define VIRTUAL_TIMER_STATS_ENABLED 0
+#endif
+
+// Number of histogram buckets. The last bucket collects everything larger
+#ifndef VIRTUAL_TIMER_STATS_BUCKETS
+#define VIRTUAL_TIMER_STATS_BUCKETS 32
+#endif
+
+// Width of each timer histogram bucket in microseconds
+#ifndef VIRTUAL_TIMER_STATS_BUCKET_US
+#define VIRTUAL_TIMER_STATS_BUCKET_US 8
+#endif
+
+// -- Types
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint32_t bucket_us; // width of each bucket in microseconds
+  uint32_t buckets[VIRTUAL_TIMER_STATS_BUCKETS];
+} timer_histogram_t;
+
+// -- Histogram functions
+//
+// Built whether or not the timer instrumentation is, since libraries/latency
+// keeps its histograms with them as well
+
+// Clear a histogram and set its bucket width
+void timer_histogram_reset(timer_histogram_t* hist, uint32_t bucket_us);
+
+// Add a value in microseconds to a histogram
+void timer_histogram_add(timer_histogram_t* hist, uint32_t value_us);
+
+// Return an upper bound on the given percentile (0-100) in microseconds
+//  Resolution is one bucket. Values in the overflow bucket report the max
+uint32_t timer_histogram_percentile(const timer_histogram_t* hist, uint8_t percentile);
+
+// Print a histogram summary and its non-empty buckets
+void timer_histogram_print(const char* name, const timer_histogram_t* hist);
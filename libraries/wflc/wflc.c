@@ -0,0 +1,117 @@
+// Weighted-frequency Fourier linear combiner
+//
+// Per sample, with phase p and the fundamental weights w1 (sine), w2 (cosine):
+//  e = s - (w1*sin(p) + w2*cos(p))
+//  w += 2*mu*e*[sin(p), cos(p)]
+//  omega += 2*mu0*e*(w1*cos(p) - w2*sin(p))
+//  p += omega
+// The frequency step is divided by the band power so the gain does not depend
+// on tremor amplitude or input units.
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "wflc.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// floor on the normalizing power, in input units squared
+static const float POWER_FLOOR = 1.0f;
+
+// time constant of the power estimate, seconds
+static const float POWER_TIME_CONSTANT = 0.5f;
+
+static float wrap_phase(float phase) {
+  if (phase >= 2.0f * (float)M_PI) {
+    phase -= 2.0f * (float)M_PI;
+  }
+  return phase;
+}
+
+// evaluate the FLC model at a phase
+static float flc_output(const wflc_t* filter, float phase) {
+  float y = 0;
+  for (int r = 0; r < WFLC_HARMONICS; r++) {
+    float angle = (r + 1) * phase;
+    y += filter->flc[r] * sinf(angle) + filter->flc[WFLC_HARMONICS + r] * cosf(angle);
+  }
+  return y;
+}
+
+void wflc_init(wflc_t* filter, const wflc_config_t* config) {
+  biquad_init_highpass(&filter->highpass, config->sample_rate_hz, config->low_hz);
+  biquad_init_lowpass(&filter->lowpass, config->sample_rate_hz, config->high_hz);
+
+  float to_omega = 2.0f * (float)M_PI / config->sample_rate_hz;
+  filter->omega = config->initial_hz * to_omega;
+  filter->omega_min = config->low_hz * to_omega;
+  filter->omega_max = config->high_hz * to_omega;
+  filter->phase = 0;
+  filter->weights[0] = 0;
+  filter->weights[1] = 0;
+  for (int i = 0; i < 2 * WFLC_HARMONICS; i++) {
+    filter->flc[i] = 0;
+  }
+  filter->power = 0;
+  filter->alpha = 1.0f - expf(-1.0f / (POWER_TIME_CONSTANT * config->sample_rate_hz));
+  filter->mu_frequency = config->mu_frequency;
+  filter->mu_weights = config->mu_weights;
+  filter->mu_flc = config->mu_flc;
+  filter->sample_rate_hz = config->sample_rate_hz;
+}
+
+float wflc_update(wflc_t* filter, float sample) {
+  float band = biquad_process(&filter->lowpass, biquad_process(&filter->highpass, sample));
+  filter->power += filter->alpha * (band * band - filter->power);
+
+  // WFLC: track frequency on the band-passed signal
+  float s = sinf(filter->phase);
+  float c = cosf(filter->phase);
+  float w1 = filter->weights[0];
+  float w2 = filter->weights[1];
+  float error = band - (w1 * s + w2 * c);
+  filter->weights[0] += 2.0f * filter->mu_weights * error * s;
+  filter->weights[1] += 2.0f * filter->mu_weights * error * c;
+
+  float norm = filter->power > POWER_FLOOR ? filter->power : POWER_FLOOR;
+  filter->omega += 2.0f * filter->mu_frequency * error * (w1 * c - w2 * s) / norm;
+  if (filter->omega < filter->omega_min) {
+    filter->omega = filter->omega_min;
+  } else if (filter->omega > filter->omega_max) {
+    filter->omega = filter->omega_max;
+  }
+
+  // FLC: model the unfiltered signal at the tracked frequency
+  float estimate = flc_output(filter, filter->phase);
+  float flc_error = sample - estimate;
+  for (int r = 0; r < WFLC_HARMONICS; r++) {
+    float angle = (r + 1) * filter->phase;
+    filter->flc[r] += 2.0f * filter->mu_flc * flc_error * sinf(angle);
+    filter->flc[WFLC_HARMONICS + r] += 2.0f * filter->mu_flc * flc_error * cosf(angle);
+  }
+
+  filter->phase = wrap_phase(filter->phase + filter->omega);
+  return estimate;
+}
+
+float wflc_predict(const wflc_t* filter, float horizon_s) {
+  // phase already points one sample past the last input
+  float ahead = horizon_s * filter->sample_rate_hz - 1.0f;
+  return flc_output(filter, filter->phase + ahead * filter->omega);
+}
+
+float wflc_frequency_hz(const wflc_t* filter) {
+  return filter->omega * filter->sample_rate_hz / (2.0f * (float)M_PI);
+}
+
+float wflc_amplitude(const wflc_t* filter) {
+  return sqrtf(filter->flc[0] * filter->flc[0] + filter->flc[WFLC_HARMONICS] * filter->flc[WFLC_HARMONICS]);
+}
+
+float wflc_phase(const wflc_t* filter) {
+  // a*sin(p) + b*cos(p) = A*sin(p + atan2(b, a)), reported at the last sample
+  float last = filter->phase - filter->omega;
+  return last + atan2f(filter->flc[WFLC_HARMONICS], filter->flc[0]);
+}
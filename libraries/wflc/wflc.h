@@ -0,0 +1,92 @@
+// Weighted-frequency Fourier linear combiner
+//
+// Adaptive tremor model for predictive cancellation. A WFLC tracks the
+// dominant tremor frequency on a band-passed copy of the motion signal, and a
+// Fourier linear combiner (FLC) at that frequency models the tremor in the
+// unfiltered signal, so the estimate carries no prefilter phase lag. The
+// model gives instantaneous frequency, amplitude, and phase, and can be
+// extrapolated ahead to cover actuator latency.
+//
+// Riviere et al., "Adaptive canceling of physiological tremor for improved
+// precision in microsurgery", IEEE Trans. Biomed. Eng., 1998
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "tremor_detect.h"
+
+// Configuration
+
+// harmonics of the tremor frequency modeled by the FLC
+#ifndef WFLC_HARMONICS
+#define WFLC_HARMONICS 2
+#endif
+
+// Types
+
+typedef struct {
+  float sample_rate_hz;  // rate wflc_update is called at
+  float low_hz;          // lower edge of the tremor band
+  float high_hz;         // upper edge of the tremor band
+  float initial_hz;      // frequency estimate to start from
+  float mu_frequency;    // frequency adaptation gain, normalized to signal power
+  float mu_weights;      // WFLC amplitude adaptation gain
+  float mu_flc;          // FLC amplitude adaptation gain
+} wflc_config_t;
+
+typedef struct {
+  biquad_t highpass;
+  biquad_t lowpass;
+  float omega;      // tremor frequency, radians per sample
+  float omega_min;
+  float omega_max;
+  float phase;      // phase of the fundamental at the current sample, radians
+  float weights[2]; // WFLC fundamental sine and cosine weights
+  float flc[2 * WFLC_HARMONICS]; // FLC sine weights, then cosine weights
+  float power;      // running mean square of the band-passed signal
+  float alpha;
+  float mu_frequency;
+  float mu_weights;
+  float mu_flc;
+  float sample_rate_hz;
+} wflc_t;
+
+// Default configuration for a 50 Hz gyro stream in degrees/second
+#define WFLC_DEFAULT_CONFIG { \
+  .sample_rate_hz = 50.0,     \
+  .low_hz = 3.0,              \
+  .high_hz = 12.0,            \
+  .initial_hz = 6.0,          \
+  .mu_frequency = 0.002,      \
+  .mu_weights = 0.02,         \
+  .mu_flc = 0.02,             \
+}
+
+
+// Function prototypes
+
+// Initialize a combiner
+//
+// filter - state to initialize, owned by the caller
+// config - band, starting frequency, and adaptation gains
+void wflc_init(wflc_t* filter, const wflc_config_t* config);
+
+// Process one sample
+//
+// Return the modeled tremor component of the sample
+float wflc_update(wflc_t* filter, float sample);
+
+// Predict the tremor component ahead of the last sample
+//
+// horizon_s - time after the last sample, e.g. the actuator latency
+float wflc_predict(const wflc_t* filter, float horizon_s);
+
+// Return the tracked tremor frequency in Hz
+float wflc_frequency_hz(const wflc_t* filter);
+
+// Return the amplitude of the tremor fundamental, in input units
+float wflc_amplitude(const wflc_t* filter);
+
+// Return the phase of the tremor fundamental at the last sample, radians
+float wflc_phase(const wflc_t* filter);
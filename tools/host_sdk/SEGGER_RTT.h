@@ -0,0 +1,13 @@
+// Host stub of SEGGER_RTT.h
+//
+// Up-buffer writes are discarded and reported as fully written
+
+#pragma once
+
+#include "host_sdk.h"
+
+#define SEGGER_RTT_MODE_NO_BLOCK_SKIP 0
+
+int SEGGER_RTT_ConfigUpBuffer(unsigned buffer_index, const char* name, void* buffer, unsigned buffer_size,
+                              unsigned flags);
+unsigned SEGGER_RTT_Write(unsigned buffer_index, const void* buffer, unsigned num_bytes);
@@ -0,0 +1,12 @@
+// Host stub of the SDK app_error.h
+
+#pragma once
+
+#include "host_sdk.h"
+
+#define APP_ERROR_CHECK(error_code) do { \
+    ret_code_t local_error = (error_code); \
+    if (local_error != NRF_SUCCESS) { \
+      host_sdk_error(local_error, __FILE__, __LINE__); \
+    } \
+  } while (0)
@@ -0,0 +1,10 @@
+// Host stub of the SDK app_util_platform.h
+//
+// Host tools are single threaded, so critical regions compile to nothing
+
+#pragma once
+
+#include "host_sdk.h"
+
+#define CRITICAL_REGION_ENTER()
+#define CRITICAL_REGION_EXIT()
@@ -0,0 +1,140 @@
+// Host SDK stubs
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "nrf_delay.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_drv_timer.h"
+#include "nrf_twi_mngr.h"
+#include "SEGGER_RTT.h"
+
+ret_code_t host_sdk_twi_schedule_result = NRF_SUCCESS;
+const void* host_sdk_twi_scheduled = NULL;
+ret_code_t host_sdk_gpiote_init_result = NRF_SUCCESS;
+
+static bool gpiote_init = false;
+static bool timer_enabled = false;
+
+void host_sdk_error(ret_code_t error_code, const char* file, int line) {
+  fprintf(stderr, "%s:%d: error %lu\n", file, line, (unsigned long)error_code);
+  exit(1);
+}
+
+void nrf_delay_ms(uint32_t ms_time) {
+  (void)ms_time;
+}
+
+void nrf_delay_us(uint32_t us_time) {
+  (void)us_time;
+}
+
+ret_code_t nrfx_timer_init(const nrf_drv_timer_t* p_instance, const nrf_drv_timer_config_t* p_config,
+                           nrf_timer_event_handler_t timer_event_handler) {
+  (void)p_instance;
+  (void)p_config;
+  (void)timer_event_handler;
+  return NRF_SUCCESS;
+}
+
+bool nrfx_timer_is_enabled(const nrf_drv_timer_t* p_instance) {
+  (void)p_instance;
+  return timer_enabled;
+}
+
+void nrfx_timer_clear(const nrf_drv_timer_t* p_instance) {
+  (void)p_instance;
+}
+
+void nrfx_timer_enable(const nrf_drv_timer_t* p_instance) {
+  (void)p_instance;
+  timer_enabled = true;
+}
+
+void nrfx_timer_disable(const nrf_drv_timer_t* p_instance) {
+  (void)p_instance;
+  timer_enabled = false;
+}
+
+uint32_t nrfx_timer_capture(const nrf_drv_timer_t* p_instance, uint32_t cc_channel) {
+  (void)p_instance;
+  (void)cc_channel;
+  return 0;
+}
+
+bool nrf_drv_gpiote_is_init(void) {
+  return gpiote_init;
+}
+
+ret_code_t nrf_drv_gpiote_init(void) {
+  if (gpiote_init) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  if (host_sdk_gpiote_init_result == NRF_SUCCESS) {
+    gpiote_init = true;
+  }
+  return host_sdk_gpiote_init_result;
+}
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, const nrf_drv_gpiote_in_config_t* p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler) {
+  (void)pin;
+  (void)p_config;
+  (void)evt_handler;
+  return NRF_SUCCESS;
+}
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable) {
+  (void)pin;
+  (void)int_enable;
+}
+
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin) {
+  (void)pin;
+}
+
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin) {
+  (void)pin;
+}
+
+ret_code_t nrf_twi_mngr_perform(const nrf_twi_mngr_t* p_nrf_twi_mngr, const void* p_config,
+                                const nrf_twi_mngr_transfer_t* p_transfers, uint8_t number_of_transfers,
+                                void (*user_function)(void)) {
+  (void)p_nrf_twi_mngr;
+  (void)p_config;
+  (void)user_function;
+  for (uint8_t i = 0; i < number_of_transfers; i++) {
+    if (p_transfers[i].operation & 1) {
+      for (uint8_t j = 0; j < p_transfers[i].length; j++) {
+        p_transfers[i].p_data[j] = 0;
+      }
+    }
+  }
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_twi_mngr_schedule(const nrf_twi_mngr_t* p_nrf_twi_mngr,
+                                 const nrf_twi_mngr_transaction_t* p_transaction) {
+  (void)p_nrf_twi_mngr;
+  if (host_sdk_twi_schedule_result == NRF_SUCCESS) {
+    host_sdk_twi_scheduled = p_transaction;
+  }
+  return host_sdk_twi_schedule_result;
+}
+
+int SEGGER_RTT_ConfigUpBuffer(unsigned buffer_index, const char* name, void* buffer, unsigned buffer_size,
+                              unsigned flags) {
+  (void)buffer_index;
+  (void)name;
+  (void)buffer;
+  (void)buffer_size;
+  (void)flags;
+  return 0;
+}
+
+unsigned SEGGER_RTT_Write(unsigned buffer_index, const void* buffer, unsigned num_bytes) {
+  (void)buffer_index;
+  (void)buffer;
+  return num_bytes;
+}
@@ -0,0 +1,35 @@
+// Host SDK stubs
+//
+// Just enough of the nRF5 SDK for the driver libraries to build and run on a
+// development machine, so host tools can test their pure logic. Peripheral
+// calls do nothing and succeed, except where a test needs to steer them
+// through the variables below.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS               0
+#define NRF_ERROR_NO_MEM          4
+#define NRF_ERROR_NOT_FOUND       5
+#define NRF_ERROR_INVALID_PARAM   7
+#define NRF_ERROR_INVALID_STATE   8
+#define NRF_ERROR_NULL            14
+#define NRF_ERROR_BUSY            17
+
+// Fail the program with the error and location, like APP_ERROR_CHECK does
+// on the board with the default fault handler
+void host_sdk_error(ret_code_t error_code, const char* file, int line);
+
+// Result returned by the next nrf_twi_mngr_schedule() calls
+extern ret_code_t host_sdk_twi_schedule_result;
+
+// Last transaction accepted by nrf_twi_mngr_schedule()
+extern const void* host_sdk_twi_scheduled;
+
+// Result returned by nrf_drv_gpiote_init()
+extern ret_code_t host_sdk_gpiote_init_result;
@@ -0,0 +1,9 @@
+// Host stub of the SDK nrf.h
+
+#pragma once
+
+#include "host_sdk.h"
+
+#define __DMB() __sync_synchronize()
+#define __WFE()
+#define __SEV()
@@ -0,0 +1,8 @@
+// Host stub of the SDK nrf_delay.h
+
+#pragma once
+
+#include "host_sdk.h"
+
+void nrf_delay_ms(uint32_t ms_time);
+void nrf_delay_us(uint32_t us_time);
@@ -0,0 +1,29 @@
+// Host stub of the SDK nrf_drv_gpiote.h
+
+#pragma once
+
+#include "host_sdk.h"
+
+typedef uint32_t nrfx_gpiote_pin_t;
+typedef uint32_t nrf_drv_gpiote_pin_t;
+typedef uint32_t nrf_gpiote_polarity_t;
+
+typedef struct {
+  uint32_t sense;
+  uint32_t pull;
+  bool is_watcher;
+  bool hi_accuracy;
+} nrf_drv_gpiote_in_config_t;
+
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+#define GPIOTE_CONFIG_IN_SENSE_LOTOHI(hi_accu) {.sense = 1, .hi_accuracy = (hi_accu)}
+#define GPIOTE_CONFIG_IN_SENSE_HITOLO(hi_accu) {.sense = 2, .hi_accuracy = (hi_accu)}
+
+bool nrf_drv_gpiote_is_init(void);
+ret_code_t nrf_drv_gpiote_init(void);
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, const nrf_drv_gpiote_in_config_t* p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin);
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin);
@@ -0,0 +1,35 @@
+// Host stub of the SDK nrf_drv_timer.h
+
+#pragma once
+
+#include "host_sdk.h"
+
+typedef struct {
+  uint8_t instance_id;
+} nrf_drv_timer_t;
+
+typedef struct {
+  uint32_t frequency;
+  uint32_t mode;
+  uint32_t bit_width;
+  uint8_t interrupt_priority;
+  void* p_context;
+} nrf_drv_timer_config_t;
+
+typedef uint32_t nrf_timer_event_t;
+typedef void (*nrf_timer_event_handler_t)(nrf_timer_event_t event_type, void* p_context);
+
+#define NRFX_TIMER_INSTANCE(id) {.instance_id = (id)}
+#define NRF_TIMER_FREQ_1MHz 4
+#define NRF_TIMER_MODE_TIMER 0
+#define NRF_TIMER_BIT_WIDTH_32 3
+#define NRFX_TIMER_DEFAULT_CONFIG_IRQ_PRIORITY 6
+#define NRF_TIMER_CC_CHANNEL0 0
+
+ret_code_t nrfx_timer_init(const nrf_drv_timer_t* p_instance, const nrf_drv_timer_config_t* p_config,
+                           nrf_timer_event_handler_t timer_event_handler);
+bool nrfx_timer_is_enabled(const nrf_drv_timer_t* p_instance);
+void nrfx_timer_clear(const nrf_drv_timer_t* p_instance);
+void nrfx_timer_enable(const nrf_drv_timer_t* p_instance);
+void nrfx_timer_disable(const nrf_drv_timer_t* p_instance);
+uint32_t nrfx_timer_capture(const nrf_drv_timer_t* p_instance, uint32_t cc_channel);
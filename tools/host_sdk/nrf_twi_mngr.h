@@ -0,0 +1,42 @@
+// Host stub of the SDK nrf_twi_mngr.h
+//
+// Transfers complete immediately and read back zeros
+
+#pragma once
+
+#include "host_sdk.h"
+
+typedef struct {
+  uint8_t instance_id;
+} nrf_twi_mngr_t;
+
+typedef struct {
+  uint8_t* p_data;
+  uint8_t length;
+  uint8_t operation;
+  uint8_t flags;
+} nrf_twi_mngr_transfer_t;
+
+typedef void (*nrf_twi_mngr_callback_t)(ret_code_t result, void* p_user_data);
+
+typedef struct {
+  nrf_twi_mngr_callback_t callback;
+  void* p_user_data;
+  const nrf_twi_mngr_transfer_t* p_transfers;
+  uint8_t number_of_transfers;
+  const void* p_required_twi_cfg;
+} nrf_twi_mngr_transaction_t;
+
+#define NRF_TWI_MNGR_NO_STOP 0x01
+#define NRF_TWI_MNGR_WRITE(address, p_buffer, byte_count, transfer_flags) \
+  {.p_data = (uint8_t*)(p_buffer), .length = (byte_count), .operation = (uint8_t)((address) << 1), \
+   .flags = (transfer_flags)}
+#define NRF_TWI_MNGR_READ(address, p_buffer, byte_count, transfer_flags) \
+  {.p_data = (uint8_t*)(p_buffer), .length = (byte_count), .operation = (uint8_t)(((address) << 1) | 1), \
+   .flags = (transfer_flags)}
+
+ret_code_t nrf_twi_mngr_perform(const nrf_twi_mngr_t* p_nrf_twi_mngr, const void* p_config,
+                                const nrf_twi_mngr_transfer_t* p_transfers, uint8_t number_of_transfers,
+                                void (*user_function)(void));
+ret_code_t nrf_twi_mngr_schedule(const nrf_twi_mngr_t* p_nrf_twi_mngr,
+                                 const nrf_twi_mngr_transaction_t* p_transaction);
@@ -0,0 +1,181 @@
+// Tremor Kalman predictor test
+//
+// Runs the tremor pipeline of servo_stabilization on a synthetic 50 Hz gyro
+// stream: the WFLC tracks the tremor frequency, the Kalman filter runs its
+// oscillator at that frequency and fuses the deadbanded integrated angle
+// with the gyro rate, and the tremor is predicted -p ahead. The stream has
+// tremor with a second harmonic whose fundamental steps from 6 to 7.5 Hz,
+// slow voluntary motion, and sensor noise.
+//
+// The predicted tremor angle and rate are compared with the true tremor
+// then, and with holding the current true tremor value, which is what
+// driving the servo from the last sample amounts to. Error statistics skip
+// the first seconds after the start and after the step, while the
+// frequency tracker converges.
+//
+// Usage: kalman_predict [-p horizon_s] [-a tremor_dps] [-v voluntary_dps] [-n noise_dps] [-x]
+//  -p  prediction horizon (default 0.04, the servo latency in the app)
+//  -a  amplitude of the tremor fundamental (default 40)
+//  -v  amplitude of 0.4 Hz voluntary motion (default 60)
+//  -n  gaussian noise standard deviation (default 2)
+//  -x  give the filter the exact tremor frequency instead of the WFLC's
+//  exits non-zero if either prediction is no better than a quarter of the
+//  hold error
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kalman.h"
+#include "wflc.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const float STEP_S = 20.0;
+static const float DURATION_S = 40.0;
+static const float FIRST_HZ = 6.0;
+static const float SECOND_HZ = 7.5;
+static const float HARMONIC_SHARE = 0.25;
+static const float HARMONIC_PHASE = 0.7;
+static const float VOLUNTARY_HZ = 0.4;
+static const float SETTLE_S = 8.0;
+
+// angle integration as in servo_stabilization
+static const float ANGLE_SCALE = 512.0;
+static const float ANGLE_DEADBAND = 5; // 0.5 degrees/second over 20 ms
+
+static float gaussian(void) {
+  // Box-Muller
+  float u1 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  float u2 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  return sqrtf(-2.0f * logf(u1)) * cosf(2 * M_PI * u2);
+}
+
+// true tremor at time t, with a phase-continuous frequency step
+static void tremor(float t, float amplitude, float* angle, float* rate) {
+  float hz = t < STEP_S ? FIRST_HZ : SECOND_HZ;
+  float phase = (t < STEP_S)
+      ? 2 * M_PI * FIRST_HZ * t
+      : 2 * M_PI * (FIRST_HZ * STEP_S + SECOND_HZ * (t - STEP_S));
+  float omega = 2 * M_PI * hz;
+  *rate = amplitude * (sinf(phase) + HARMONIC_SHARE * sinf(2 * phase + HARMONIC_PHASE));
+  *angle = -amplitude / omega * (cosf(phase) + HARMONIC_SHARE / 2 * cosf(2 * phase + HARMONIC_PHASE));
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+  float horizon_s = 0.04;
+  float amplitude = 40;
+  float voluntary = 60;
+  float noise = 2;
+  bool exact_frequency = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:a:v:n:x")) != -1) {
+    switch (opt) {
+      case 'p': horizon_s = atof(optarg); break;
+      case 'a': amplitude = atof(optarg); break;
+      case 'v': voluntary = atof(optarg); break;
+      case 'n': noise = atof(optarg); break;
+      case 'x': exact_frequency = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-p horizon_s] [-a tremor_dps] [-v voluntary_dps] [-n noise_dps] [-x]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  wflc_config_t wflc_config = WFLC_DEFAULT_CONFIG;
+  kalman_config_t kalman_config = KALMAN_DEFAULT_CONFIG;
+  wflc_t tracker;
+  kalman_t filter;
+  wflc_init(&tracker, &wflc_config);
+  kalman_init(&filter, &kalman_config);
+  srand(1);
+
+  float dt = 1.0 / kalman_config.sample_rate_hz;
+  uint32_t samples = DURATION_S * kalman_config.sample_rate_hz;
+  float angle = 0;
+  double angle_square[2] = {0, 0};
+  double rate_square[2] = {0, 0};
+  uint32_t count = 0;
+  float* rates = malloc(samples * sizeof(float));
+  float* angles = malloc(samples * sizeof(float));
+
+  for (uint32_t i = 0; i < samples; i++) {
+    float t = i * dt;
+    float tremor_angle;
+    float tremor_rate;
+    tremor(t, amplitude, &tremor_angle, &tremor_rate);
+    float rate = tremor_rate + voluntary * sinf(2 * M_PI * VOLUNTARY_HZ * t) + noise * gaussian();
+
+    // quantized, deadbanded integration, as the firmware angle estimate
+    float delta = roundf(rate * dt * ANGLE_SCALE);
+    if (fabsf(delta) > ANGLE_DEADBAND) {
+      angle += delta / ANGLE_SCALE;
+    }
+
+    rates[i] = rate;
+    angles[i] = angle;
+
+    wflc_update(&tracker, rate);
+    kalman_set_frequency(&filter, exact_frequency ? (t < STEP_S ? FIRST_HZ : SECOND_HZ) : wflc_frequency_hz(&tracker));
+    kalman_update(&filter, angle, rate);
+    kalman_prediction_t predicted = kalman_predict(&filter, horizon_s);
+
+    bool settled = (t >= SETTLE_S && t < STEP_S) || t >= STEP_S + SETTLE_S;
+    // the horizon must not straddle the step
+    if (!settled || (t < STEP_S && t + horizon_s >= STEP_S)) {
+      continue;
+    }
+    float future_angle;
+    float future_rate;
+    tremor(t + horizon_s, amplitude, &future_angle, &future_rate);
+    angle_square[0] += powf(predicted.tremor_angle - future_angle, 2);
+    angle_square[1] += powf(tremor_angle - future_angle, 2);
+    rate_square[0] += powf(predicted.tremor_rate - future_rate, 2);
+    rate_square[1] += powf(tremor_rate - future_rate, 2);
+    count++;
+  }
+
+  // time the pipeline on the same stream
+  wflc_init(&tracker, &wflc_config);
+  kalman_init(&filter, &kalman_config);
+  volatile float output = 0;
+  double start = now_ns();
+  for (uint32_t i = 0; i < samples; i++) {
+    wflc_update(&tracker, rates[i]);
+    kalman_set_frequency(&filter, wflc_frequency_hz(&tracker));
+    kalman_update(&filter, angles[i], rates[i]);
+    output = kalman_predict(&filter, horizon_s).tremor_rate;
+  }
+  (void)output;
+  double update_ns = (now_ns() - start) / samples;
+  free(rates);
+  free(angles);
+
+  float angle_rms[2] = {sqrt(angle_square[0] / count), sqrt(angle_square[1] / count)};
+  float rate_rms[2] = {sqrt(rate_square[0] / count), sqrt(rate_square[1] / count)};
+
+  printf("tremor %.0f dps at %.1f then %.1f Hz with a %.0f%% harmonic, voluntary %.0f dps, noise %.1f dps\n",
+      amplitude, FIRST_HZ, SECOND_HZ, HARMONIC_SHARE * 100, voluntary, noise);
+  printf("frequency from %s\n", exact_frequency ? "the true tremor" : "the WFLC");
+  printf("%.0f ms prediction   predicted  hold\n", horizon_s * 1000);
+  printf("tremor angle (deg)  %9.2f  %5.2f\n", angle_rms[0], angle_rms[1]);
+  printf("tremor rate (dps)   %9.2f  %5.2f\n", rate_rms[0], rate_rms[1]);
+  printf("%.1f ns per sample for tracker, filter, and prediction\n", update_ns);
+
+  bool ok = angle_rms[0] < angle_rms[1] / 4 && rate_rms[0] < rate_rms[1] / 4;
+  printf("%s\n", ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}
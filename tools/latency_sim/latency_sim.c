@@ -0,0 +1,202 @@
+// Sensor-to-actuation latency simulation
+//
+// Runs the latency instrumentation against the simulated virtual timer
+// backend, with the control step and PWM frames scheduled the way
+// apps/servo_stabilization schedules them: a deferred repeated timer runs
+// the control step, which spends modeled time reading the IMU, computing,
+// and writing the servo update, and an interrupt timer stands in for the PWM
+// frame interrupt that applies it. The servo output follows the servo
+// library: updates are counted, a direct write plays from the next frame,
+// and with -m the update goes through the apps' motion profile, which takes
+// its first step at the next frame boundary and so plays a frame later. The
+// histograms printed are the ones the firmware dumps over RTT.
+//
+// The control step commands a tremor cancelling pulse width, so with -m the
+// tool also reports the gain and delay of the played pulse against the
+// commanded one at the tremor frequency, the lag the profile adds on top of
+// the frame wait.
+//
+// Usage: latency_sim [-p period_us] [-r read_us] [-c compute_us] [-j jitter_us]
+//                    [-f frame_offset_us] [-d seconds] [-m] [-a amplitude_us]
+//                    [-t tremor_hz] [-s]
+//  -p  control period (default 20000, poll_period in the app)
+//  -r  IMU read time (default 2000, two 100 kHz I2C transactions)
+//  -c  algorithm time, including its RTT prints (default 500)
+//  -j  random extra read time, up to this much (default 200)
+//  -f  time from a control step to the next PWM frame start (default 10000)
+//  -d  simulated duration (default 60 s)
+//  -m  drive the servo through the motion profile the apps enable
+//  -a  commanded pulse amplitude around the stop point (default 60 us, about
+//      2 degrees of tremor at 6 Hz)
+//  -t  commanded tremor frequency (default 6 Hz)
+//  -s  sweep the frame offset across one frame instead, printing the
+//      sensor-to-actuation median and 99th percentile of each
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "latency.h"
+#include "motion.h"
+#include "virtual_timer.h"
+#include "virtual_timer_hal_sim.h"
+
+// PWM frame period, as in the servo library
+static const uint32_t FRAME_US = 20000;
+
+// time to write the PWM buffer
+static const uint32_t COMMIT_US = 10;
+
+// motion profile limits of the apps, in us from the stop point
+static const motion_config_t MOTION = {
+  .max_velocity = 10000,
+  .max_acceleration = 300000,
+};
+
+static uint32_t read_us = 2000;
+static uint32_t compute_us = 500;
+static uint32_t jitter_us = 200;
+static float amplitude_us = 60;
+static float tremor_hz = 6;
+
+// servo library model, with updates requested, held by the buffer for the
+// next frame, and played by the current frame
+static bool profiled = false;
+static motion_profile_t profile;
+static uint32_t requested;
+static uint32_t swapped;
+static uint32_t playing;
+static float target_us;
+static float output_us;
+
+// played pulse width against the command at the tremor frequency
+static double command_sum[2];
+static double played_sum[2];
+
+// one control step, spending the modeled time in each stage
+static void control_tick(void) {
+  LATENCY_MARK(LATENCY_READ_START);
+  float t = read_timer64() / 1e6;
+  virtual_timer_sim_advance(read_us + (jitter_us ? (uint32_t)rand() % (jitter_us + 1) : 0));
+  LATENCY_MARK(LATENCY_READ_END);
+  virtual_timer_sim_advance(compute_us);
+  LATENCY_MARK(LATENCY_COMPUTED);
+  virtual_timer_sim_advance(COMMIT_US);
+
+  // a profiled write only sets the target, a direct one swaps a buffer
+  target_us = amplitude_us * sinf(2 * M_PI * tremor_hz * t);
+  requested++;
+  if (!profiled) {
+    output_us = target_us;
+    swapped = requested;
+  }
+  LATENCY_COMMIT(requested);
+}
+
+// PWM frame interrupt
+static void servo_frame(void) {
+  playing = swapped;
+  LATENCY_APPLY(playing);
+
+  // the frame plays output_us, against what the control step last commanded
+  double phase = 2 * M_PI * tremor_hz * (read_timer64() / 1e6);
+  command_sum[0] += target_us * cos(phase);
+  command_sum[1] += target_us * sin(phase);
+  played_sum[0] += output_us * cos(phase);
+  played_sum[1] += output_us * sin(phase);
+
+  if (profiled) {
+    output_us = motion_update(&profile, target_us);
+    swapped = requested;
+  }
+}
+
+// simulate with fresh histograms, with frames starting offset_us after each
+// control step is scheduled
+static void run(uint32_t period_us, uint32_t offset_us, uint32_t seconds) {
+  srand(1);
+  latency_reset();
+  motion_init(&profile, &MOTION, FRAME_US / 1e6f, 0);
+  requested = swapped = playing = 0;
+  target_us = output_us = 0;
+  command_sum[0] = command_sum[1] = played_sum[0] = played_sum[1] = 0;
+
+  uint32_t control = virtual_timer_start_repeated_deferred(period_us, control_tick);
+  virtual_timer_sim_advance(offset_us % FRAME_US);
+  uint32_t frames = virtual_timer_start_repeated(FRAME_US, servo_frame);
+
+  uint64_t end = read_timer64() + (uint64_t)seconds * 1000000;
+  while (read_timer64() < end) {
+    virtual_timer_dispatch();
+    virtual_timer_idle();
+  }
+
+  virtual_timer_cancel(control);
+  virtual_timer_cancel(frames);
+  virtual_timer_dispatch();
+}
+
+int main(int argc, char** argv) {
+  uint32_t period_us = 20000;
+  uint32_t offset_us = 10000;
+  uint32_t seconds = 60;
+  bool sweep = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:r:c:j:f:d:ma:t:s")) != -1) {
+    switch (opt) {
+      case 'p': period_us = atoi(optarg); break;
+      case 'r': read_us = atoi(optarg); break;
+      case 'c': compute_us = atoi(optarg); break;
+      case 'j': jitter_us = atoi(optarg); break;
+      case 'f': offset_us = atoi(optarg); break;
+      case 'd': seconds = atoi(optarg); break;
+      case 'm': profiled = true; break;
+      case 'a': amplitude_us = atof(optarg); break;
+      case 't': tremor_hz = atof(optarg); break;
+      case 's': sweep = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-p period_us] [-r read_us] [-c compute_us] [-j jitter_us] "
+            "[-f frame_offset_us] [-d seconds] [-m] [-a amplitude_us] [-t tremor_hz] [-s]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (period_us == 0 || seconds == 0 || read_us + jitter_us + compute_us + COMMIT_US >= period_us) {
+    fprintf(stderr, "the control step must fit in a nonzero period\n");
+    return 1;
+  }
+
+  virtual_timer_init();
+  latency_init();
+
+  if (!sweep) {
+    run(period_us, offset_us, seconds);
+    latency_print();
+
+    // delay of the played pulse behind the command, from the phase at the
+    // tremor frequency
+    double command_amplitude = hypot(command_sum[0], command_sum[1]);
+    double played_amplitude = hypot(played_sum[0], played_sum[1]);
+    // the sums give atan2 of pi/2 minus the phase of each
+    double lag = atan2(played_sum[1], played_sum[0]) - atan2(command_sum[1], command_sum[0]);
+    lag = fmod(lag + 4 * M_PI, 2 * M_PI);
+    printf("Output at %.1f Hz: gain %.2f, %.1f ms behind the command%s\n", tremor_hz,
+        played_amplitude / command_amplitude, lag / (2 * M_PI * tremor_hz) * 1e3,
+        profiled ? ", through the motion profile" : "");
+    return 0;
+  }
+
+  printf("frame_offset_us,p50_us,p99_us\n");
+  for (uint32_t offset = 0; offset < FRAME_US; offset += 1000) {
+    run(period_us, offset, seconds);
+    timer_histogram_t total;
+    latency_get(LATENCY_STAGE_TOTAL, &total);
+    printf("%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n", offset,
+        timer_histogram_percentile(&total, 50), timer_histogram_percentile(&total, 99));
+  }
+  return 0;
+}
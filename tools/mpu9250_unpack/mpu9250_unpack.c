@@ -0,0 +1,78 @@
+// MPU-9250 sample unpacking test
+//
+// Feeds mpu9250_unpack_sample() hand-built 14-byte register bursts and checks
+// that every field comes out with the right byte order, sign, and scale:
+//  accel at 16384 LSB/g, temperature at 333.87 LSB/degree C from 21 degrees C,
+//  gyro at 16.4 LSB/(degree/second)
+//
+// Usage: mpu9250_unpack
+//  exits non-zero if any field is wrong
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mpu9250.h"
+
+typedef struct {
+  const char* name;
+  int16_t raw[7]; // accel x/y/z, temperature, gyro x/y/z
+  mpu9250_sample_t expected;
+} unpack_case_t;
+
+static const unpack_case_t cases[] = {
+  {"zero", {0, 0, 0, 0, 0, 0, 0},
+    {{0, 0, 0}, 21.0, {0, 0, 0}}},
+  {"one g and 20 dps", {16384, -16384, 1, 0, 328, -328, -1},
+    {{1.0, -1.0, 1.0 / 16384}, 21.0, {20.0, -20.0, -1.0 / 16.4}}},
+  {"byte order", {0x0102, 0x0304, 0x0506, 0x0708, 0x090A, 0x0B0C, 0x0D0E},
+    {{0x0102 / 16384.0, 0x0304 / 16384.0, 0x0506 / 16384.0}, 0x0708 / 333.87 + 21.0,
+      {0x090A / 16.4, 0x0B0C / 16.4, 0x0D0E / 16.4}}},
+  {"full scale", {32767, -32768, -32768, -32768, 32767, -32768, 32767},
+    {{32767 / 16384.0, -2.0, -2.0}, -32768 / 333.87 + 21.0, {32767 / 16.4, -32768 / 16.4, 32767 / 16.4}}},
+  {"high byte sign", {-256, 255, -255, 1335, 0x7F00, -0x7F00, 0x0080},
+    {{-256 / 16384.0, 255 / 16384.0, -255 / 16384.0}, 1335 / 333.87 + 21.0, {0x7F00 / 16.4, -0x7F00 / 16.4, 0x80 / 16.4}}},
+};
+
+static bool check(const char* case_name, const char* field, float actual, double expected) {
+  // single precision, so compare relative to the value
+  double tolerance = 1e-6 * fabs(expected) + 1e-6;
+  if (fabs(actual - expected) > tolerance) {
+    printf("FAIL %s: %s is %f, expected %f\n", case_name, field, actual, expected);
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  int failures = 0;
+  for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const unpack_case_t* test = &cases[i];
+
+    // registers are big endian, high byte first
+    uint8_t buf[MPU9250_SAMPLE_BYTES] = {0};
+    for (int j = 0; j < 7; j++) {
+      buf[2 * j] = (uint16_t)test->raw[j] >> 8;
+      buf[2 * j + 1] = (uint16_t)test->raw[j] & 0xFF;
+    }
+
+    mpu9250_sample_t sample = mpu9250_unpack_sample(buf);
+    bool ok = true;
+    ok &= check(test->name, "accel x", sample.accel.x_axis, test->expected.accel.x_axis);
+    ok &= check(test->name, "accel y", sample.accel.y_axis, test->expected.accel.y_axis);
+    ok &= check(test->name, "accel z", sample.accel.z_axis, test->expected.accel.z_axis);
+    ok &= check(test->name, "temperature", sample.temperature, test->expected.temperature);
+    ok &= check(test->name, "gyro x", sample.gyro.x_axis, test->expected.gyro.x_axis);
+    ok &= check(test->name, "gyro y", sample.gyro.y_axis, test->expected.gyro.y_axis);
+    ok &= check(test->name, "gyro z", sample.gyro.z_axis, test->expected.gyro.z_axis);
+    if (ok) {
+      printf("ok   %s\n", test->name);
+    } else {
+      failures++;
+    }
+  }
+
+  printf("%d of %u cases failed\n", failures, (unsigned)(sizeof(cases) / sizeof(cases[0])));
+  return failures ? 1 : 0;
+}
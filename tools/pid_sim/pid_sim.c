@@ -0,0 +1,336 @@
+// Stabilization PID closed-loop simulation
+//
+// Runs the control library against a model of the hand and a continuous
+// rotation servo, the way apps/servo_stabilization does: every 20 ms the
+// controller sees the tremor angle of the hand plus its own estimate of how
+// far it has turned the servo, with the tremor rate as feed-forward, and
+// commands a servo speed that takes effect at the next PWM frame. Like the
+// app, it sees the tremor predicted ahead by the servo latency by the WFLC
+// tracked Kalman filter, from the gyro rate and the deadbanded angle
+// integrated from it. The command goes through the servo library's motion
+// profile, one step per frame, and the controller estimates the servo angle
+// from that profiled output as the app does. The servo reaches the profiled
+// speed with a first order lag. The residual angle is hand tremor plus servo
+// rotation, so perfect cancellation is zero.
+//
+// The float and Q15 controllers run the same loop, along with feed-forward
+// alone for reference, and the tool reports RMS residual and the cost of
+// one update of each controller.
+//
+// Usage: pid_sim [-p kp] [-i ki] [-d kd] [-c derivative_hz] [-f tremor_hz]
+//                [-a amplitude] [-t tau] [-l latency] [-V velocity]
+//                [-A acceleration] [-x] [-o out.csv]
+//  -p, -i, -d  gains, servo speed per degree (default 0.05, 0.5, 0.0005)
+//  -c  derivative low-pass cutoff (default 10 Hz)
+//  -f  tremor frequency (default 6 Hz)
+//  -a  tremor amplitude (default 2 degrees)
+//  -t  servo speed time constant (default 0.03 s)
+//  -l  prediction horizon (default 0.04 s, servo_latency in the app)
+//  -V  profile velocity limit, us per second (default as the apps)
+//  -A  profile acceleration limit, us per second squared (default as the
+//      apps), 0 to output commands directly
+//  -x  predict the tremor exactly from the model instead of the filter
+//  -o  write time, hand, and residual angles of every controller as CSV
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "kalman.h"
+#include "motion.h"
+#include "wflc.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// control period and simulation step, seconds
+static const double PERIOD_S = 0.02;
+static const double STEP_S = 0.0005;
+static const double DURATION_S = 20.0;
+
+// RMS is measured after this much settling
+static const double SETTLE_S = 2.0;
+
+// servo speed at full command, degrees/second, as in the app
+static const double FULL_SPEED = 600.0;
+
+// pulse width from the stop point to full speed, as the app's calibration
+// maps it, leaving out the 4 us deadband
+static const double PULSE_RANGE_US = 486.0;
+
+// fixed point scales of the Q15 controller, as in sd_card
+static const double ANGLE_SCALE = 32.0;   // LSBs per degree
+static const double SPEED_SCALE = 32767.0; // LSBs per full speed
+
+// gyro angle integration, as in servo_stabilization
+static const double GYRO_ANGLE_SCALE = 512.0; // LSBs per degree
+static const double GYRO_ANGLE_DEADBAND = 5; // 0.5 degrees/second over 20 ms
+
+typedef enum {
+  FEEDFORWARD,
+  PID_FLOAT,
+  PID_Q15,
+  CONTROLLERS,
+} controller_t;
+
+static const char* const NAMES[CONTROLLERS] = {"feedforward", "float", "q15"};
+
+typedef struct {
+  double tremor_hz;
+  double amplitude;
+  double tau;
+  double latency;
+  motion_config_t motion; // max_acceleration 0 for no profile
+  bool exact;             // predict from the model instead of the filter
+} model_t;
+
+
+static double hand_angle(const model_t* model, double t) {
+  return model->amplitude * sin(2 * M_PI * model->tremor_hz * t);
+}
+
+static double hand_rate(const model_t* model, double t) {
+  return 2 * M_PI * model->tremor_hz * model->amplitude * cos(2 * M_PI * model->tremor_hz * t);
+}
+
+// scale a configuration in degrees and servo speed to LSBs
+static pid_config_t q15_config(const pid_config_t* config) {
+  pid_config_t scaled = *config;
+  double lsb_gain = SPEED_SCALE / ANGLE_SCALE;
+  scaled.kp *= lsb_gain;
+  scaled.ki *= lsb_gain;
+  scaled.kd *= lsb_gain;
+  scaled.output_min *= SPEED_SCALE;
+  scaled.output_max *= SPEED_SCALE;
+  return scaled;
+}
+
+// quantize, saturating like the app's fixed point conversions
+static int16_t to_int16(double value) {
+  return (int16_t)fmax(fmin(round(value), INT16_MAX), INT16_MIN);
+}
+
+// predicted tremor angle and rate at t + latency
+typedef struct {
+  wflc_t wflc;
+  kalman_t kalman;
+  double angle; // deadbanded gyro angle, degrees
+} predictor_t;
+
+static void predictor_init(predictor_t* predictor) {
+  wflc_config_t wflc_config = WFLC_DEFAULT_CONFIG;
+  wflc_config.sample_rate_hz = 1.0 / PERIOD_S;
+  kalman_config_t kalman_config = KALMAN_DEFAULT_CONFIG;
+  kalman_config.sample_rate_hz = 1.0 / PERIOD_S;
+  wflc_init(&predictor->wflc, &wflc_config);
+  kalman_init(&predictor->kalman, &kalman_config);
+  predictor->angle = 0;
+}
+
+static void predict(predictor_t* predictor, const model_t* model, double t, double* angle,
+    double* rate) {
+  if (model->exact) {
+    *angle = hand_angle(model, t + model->latency);
+    *rate = hand_rate(model, t + model->latency);
+    return;
+  }
+
+  // the gyro reads the hand, and the app integrates it in fixed point
+  double gyro = hand_rate(model, t);
+  double delta = round(gyro * PERIOD_S * GYRO_ANGLE_SCALE);
+  if (fabs(delta) > GYRO_ANGLE_DEADBAND) {
+    predictor->angle += delta / GYRO_ANGLE_SCALE;
+  }
+
+  wflc_update(&predictor->wflc, gyro);
+  kalman_set_frequency(&predictor->kalman, wflc_frequency_hz(&predictor->wflc));
+  kalman_update(&predictor->kalman, predictor->angle, gyro);
+  kalman_prediction_t predicted = kalman_predict(&predictor->kalman, model->latency);
+  *angle = predicted.tremor_angle;
+  *rate = predicted.tremor_rate;
+}
+
+// return the RMS residual angle after settling
+static double simulate(controller_t controller, const pid_config_t* config, const model_t* model,
+    double* trace) {
+  pid_controller_t pid;
+  pid_init(&pid, config);
+
+  pid_config_t scaled = q15_config(config);
+  pid_q15_controller_t pid_q15;
+  pid_q15_init(&pid_q15, &scaled);
+
+  predictor_t predictor;
+  predictor_init(&predictor);
+
+  // the servo library steps the profile in pulse widths from the stop point
+  bool profiled = model->motion.max_acceleration > 0;
+  motion_profile_t profile;
+  motion_init(&profile, &model->motion, PERIOD_S, 0);
+
+  int period_steps = (int)round(PERIOD_S / STEP_S);
+  int steps = (int)round(DURATION_S / STEP_S);
+  double output = 0;        // profiled speed applied at the current frame
+  double command = 0;       // speed the controller last asked for
+  double servo_speed = 0;   // degrees/second
+  double servo_angle = 0;
+  double estimate = 0;      // servo angle the controller believes
+  double square_sum = 0;
+  int samples = 0;
+
+  for (int step = 0; step < steps; step++) {
+    double t = step * STEP_S;
+
+    if (step % period_steps == 0) {
+      output = profiled ? motion_update(&profile, command * PULSE_RANGE_US) / PULSE_RANGE_US : command;
+      estimate += output * FULL_SPEED * PERIOD_S;
+
+      double tremor_angle, tremor_rate;
+      predict(&predictor, model, t, &tremor_angle, &tremor_rate);
+      double measurement = tremor_angle + estimate;
+      double feedforward = -tremor_rate / FULL_SPEED;
+      if (controller == PID_FLOAT) {
+        command = pid_update(&pid, 0, measurement, feedforward);
+      } else if (controller == PID_Q15) {
+        int16_t q15 = pid_q15_update(&pid_q15, 0, to_int16(measurement * ANGLE_SCALE),
+            to_int16(feedforward * SPEED_SCALE));
+        command = q15 / SPEED_SCALE;
+      } else {
+        command = fmax(fmin(feedforward, config->output_max), config->output_min);
+      }
+    }
+
+    servo_speed += (output * FULL_SPEED - servo_speed) * STEP_S / model->tau;
+    servo_angle += servo_speed * STEP_S;
+
+    double residual = hand_angle(model, t) + servo_angle;
+    if (trace) {
+      trace[step] = residual;
+    }
+    if (t >= SETTLE_S) {
+      square_sum += residual * residual;
+      samples++;
+    }
+  }
+
+  return sqrt(square_sum / samples);
+}
+
+// time one update of each PID controller, in nanoseconds
+static void benchmark(const pid_config_t* config, double* float_ns, double* q15_ns) {
+  const int iterations = 10000000;
+  pid_controller_t pid;
+  pid_init(&pid, config);
+  pid_config_t scaled = q15_config(config);
+  pid_q15_controller_t pid_q15;
+  pid_q15_init(&pid_q15, &scaled);
+
+  volatile float sink = 0;
+  clock_t start = clock();
+  for (int i = 0; i < iterations; i++) {
+    sink = pid_update(&pid, 0, (i & 63) * 0.1f, 0.01f);
+  }
+  *float_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / iterations;
+
+  volatile int16_t q15_sink = 0;
+  start = clock();
+  for (int i = 0; i < iterations; i++) {
+    q15_sink = pid_q15_update(&pid_q15, 0, (i & 63) * 3, 300);
+  }
+  *q15_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / iterations;
+  (void)sink;
+  (void)q15_sink;
+}
+
+int main(int argc, char** argv) {
+  pid_config_t config = PID_DEFAULT_CONFIG;
+  config.kp = 0.05;
+  config.ki = 0.5;
+  config.kd = 0.0005;
+  config.sample_rate_hz = 1.0 / PERIOD_S;
+  model_t model = {
+    .tremor_hz = 6.0,
+    .amplitude = 2.0,
+    .tau = 0.03,
+    .latency = 0.04,
+    .motion = {
+      .max_velocity = 10000,
+      .max_acceleration = 300000,
+    },
+    .exact = false,
+  };
+  const char* out = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:i:d:c:f:a:t:l:V:A:xo:")) != -1) {
+    switch (opt) {
+      case 'p': config.kp = atof(optarg); break;
+      case 'i': config.ki = atof(optarg); break;
+      case 'd': config.kd = atof(optarg); break;
+      case 'c': config.derivative_hz = atof(optarg); break;
+      case 'f': model.tremor_hz = atof(optarg); break;
+      case 'a': model.amplitude = atof(optarg); break;
+      case 't': model.tau = atof(optarg); break;
+      case 'l': model.latency = atof(optarg); break;
+      case 'V': model.motion.max_velocity = atof(optarg); break;
+      case 'A': model.motion.max_acceleration = atof(optarg); break;
+      case 'x': model.exact = true; break;
+      case 'o': out = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-p kp] [-i ki] [-d kd] [-c derivative_hz] [-f tremor_hz] "
+            "[-a amplitude] [-t tau] [-l latency] [-V velocity] [-A acceleration] [-x] [-o out.csv]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (model.tremor_hz <= 0 || model.tau <= 0) {
+    fprintf(stderr, "tremor frequency and time constant must be positive\n");
+    return 1;
+  }
+
+  int steps = (int)round(DURATION_S / STEP_S);
+  double* traces[CONTROLLERS] = {NULL};
+  if (out) {
+    for (int c = 0; c < CONTROLLERS; c++) {
+      traces[c] = malloc(steps * sizeof(double));
+      if (!traces[c]) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+      }
+    }
+  }
+
+  printf("tremor: %.1f Hz, %.2f deg RMS\n", model.tremor_hz, model.amplitude / sqrt(2));
+  for (int c = 0; c < CONTROLLERS; c++) {
+    double residual = simulate(c, &config, &model, traces[c]);
+    printf("%-12s residual %.3f deg RMS (%5.1f dB)\n", NAMES[c], residual,
+        20 * log10(residual / (model.amplitude / sqrt(2))));
+  }
+  double float_ns, q15_ns;
+  benchmark(&config, &float_ns, &q15_ns);
+  printf("update: float %.1f ns, q15 %.1f ns\n", float_ns, q15_ns);
+
+  if (out) {
+    FILE* csv = fopen(out, "w");
+    if (!csv) {
+      perror(out);
+      return 1;
+    }
+    fprintf(csv, "time_s,hand_deg,feedforward_deg,float_deg,q15_deg\n");
+    for (int step = 0; step < steps; step++) {
+      double t = step * STEP_S;
+      fprintf(csv, "%f,%f,%f,%f,%f\n", t, hand_angle(&model, t), traces[FEEDFORWARD][step],
+          traces[PID_FLOAT][step], traces[PID_Q15][step]);
+    }
+    fclose(csv);
+    for (int c = 0; c < CONTROLLERS; c++) {
+      free(traces[c]);
+    }
+  }
+  return 0;
+}
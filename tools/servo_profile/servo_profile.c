@@ -0,0 +1,252 @@
+// Servo motion profile simulation
+//
+// Drives a model of the continuous rotation servos the apps use, once
+// directly and once through the motion profile the servo library applies,
+// with a new pulse width every 20 ms PWM frame like the firmware. The pulse
+// width offset from the stop point sets the servo speed, which the motor
+// reaches with a first order lag, as in tools/pid_sim.
+//
+// Two command patterns are run:
+//  - steps: one way, the other way through stop, half speed, stop. Reports
+//    the peak shaft acceleration, the jolt the profile exists to limit, and
+//    the worst time to settle at the new speed
+//  - tremor: a sinusoidal speed command of the size the stabilization loop
+//    sends. Reports the gain and delay of the shaft speed at the command
+//    frequency, which the profile limits must leave alone
+//
+// The default limits pass a tremor command of 80 us at 8 Hz (countering 2
+// degrees of tremor with a 600 degree/second servo), which needs 4000 us/s
+// and 200000 us/s^2, and take about 80 ms to ramp from stop to full speed.
+//
+// Usage: servo_profile [-v velocity] [-a acceleration] [-s step] [-t tau]
+//                      [-A amplitude] [-f hz] [-o out.csv]
+//  -v  profile velocity limit, us per second (default 10000, as the apps)
+//  -a  profile acceleration limit, us per second squared (default 300000, as
+//      the apps)
+//  -s  step size from the stop point, us (default 486, stop to full speed)
+//  -t  servo speed time constant, seconds (default 0.03)
+//  -A  tremor command amplitude, us (default 80)
+//  -f  tremor command frequency (default 8 Hz)
+//  -o  write time, commands, and responses as CSV
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "motion.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// PWM frame and simulation step, seconds
+static const float FRAME_S = 0.02;
+static const float STEP_S = 0.0005;
+
+// pulse width from the stop point to full speed, as the app's calibration
+// maps it, and the speed it gives
+static const float PULSE_RANGE_US = 486.0;
+static const float FULL_SPEED = 600.0; // degrees/second
+
+// servo speed loop time constant
+static float tau = 0.03;
+
+// each step command is held this long
+static const float HOLD_S = 1.0;
+
+// the tremor command runs this long, measured after the first second
+static const float TREMOR_S = 5.0;
+static const float SETTLE_S = 1.0;
+
+// settled once within this fraction of the step
+static const float SETTLE_BAND = 0.02;
+
+typedef struct {
+  float speed;        // degrees/second
+  float acceleration; // degrees/second^2
+} plant_t;
+
+// advance the model servo one simulation step toward a pulse width offset
+static void plant_step(plant_t* plant, float command_us) {
+  float target = command_us / PULSE_RANGE_US * FULL_SPEED;
+  plant->acceleration = (target - plant->speed) / tau;
+  plant->speed += plant->acceleration * STEP_S;
+}
+
+typedef struct {
+  float peak_acceleration; // degrees/second^2
+  float settle_s;          // worst time to settle after a step
+} step_response_t;
+
+// run the step sequence, offsets from the stop point in us, through the
+// model, optionally profiled
+static step_response_t simulate_steps(const float* commands, int count, const motion_config_t* config,
+    FILE* csv, int column) {
+  motion_profile_t profile;
+  if (config) {
+    motion_init(&profile, config, FRAME_S, 0);
+  }
+  plant_t plant = {0};
+  step_response_t response = {0};
+
+  int frame_steps = (int)roundf(FRAME_S / STEP_S);
+  int hold_frames = (int)roundf(HOLD_S / FRAME_S);
+  float previous = 0;
+  int step = 0;
+  for (int c = 0; c < count; c++) {
+    float target = commands[c] / PULSE_RANGE_US * FULL_SPEED;
+    float size = fabsf(target - previous);
+    float settled_at = 0;
+
+    for (int f = 0; f < hold_frames; f++) {
+      float output = config ? motion_update(&profile, commands[c]) : commands[c];
+      for (int s = 0; s < frame_steps; s++, step++) {
+        plant_step(&plant, output);
+        float time_s = (f * frame_steps + s) * STEP_S;
+        response.peak_acceleration = fmaxf(response.peak_acceleration, fabsf(plant.acceleration));
+        if (fabsf(plant.speed - target) > SETTLE_BAND * size) {
+          settled_at = time_s + STEP_S;
+        }
+        if (csv) {
+          fprintf(csv, "steps,%d,%f,%f,%f\n", column, step * STEP_S, output, plant.speed);
+        }
+      }
+    }
+
+    if (size > 0) {
+      response.settle_s = fmaxf(response.settle_s, settled_at);
+    }
+    previous = target;
+  }
+  return response;
+}
+
+typedef struct {
+  float gain;     // shaft speed over commanded speed at the command frequency
+  float delay_ms; // shaft speed behind the command
+} tremor_response_t;
+
+// run a sinusoidal speed command through the model, optionally profiled
+static tremor_response_t simulate_tremor(float amplitude_us, float hz, const motion_config_t* config,
+    FILE* csv, int column) {
+  motion_profile_t profile;
+  if (config) {
+    motion_init(&profile, config, FRAME_S, 0);
+  }
+  plant_t plant = {0};
+
+  // correlate the command and the shaft speed with sine and cosine
+  int frame_steps = (int)roundf(FRAME_S / STEP_S);
+  int frames = (int)roundf((SETTLE_S + TREMOR_S) / FRAME_S);
+  double command_sums[2] = {0, 0};
+  double speed_sums[2] = {0, 0};
+  int step = 0;
+  for (int f = 0; f < frames; f++) {
+    float command = amplitude_us * sinf(2 * M_PI * hz * f * FRAME_S);
+    float output = config ? motion_update(&profile, command) : command;
+    for (int s = 0; s < frame_steps; s++, step++) {
+      plant_step(&plant, output);
+      float time_s = step * STEP_S;
+      if (time_s >= SETTLE_S) {
+        // the command a frame holds, against the speed it produces
+        float phase = 2 * M_PI * hz * time_s;
+        command_sums[0] += command * sinf(phase);
+        command_sums[1] += command * cosf(phase);
+        speed_sums[0] += plant.speed * sinf(phase);
+        speed_sums[1] += plant.speed * cosf(phase);
+      }
+      if (csv) {
+        fprintf(csv, "tremor,%d,%f,%f,%f\n", column, time_s, output, plant.speed);
+      }
+    }
+  }
+
+  float command_speed = hypot(command_sums[0], command_sums[1]) / PULSE_RANGE_US * FULL_SPEED;
+  float lag = atan2(command_sums[1], command_sums[0]) - atan2(speed_sums[1], speed_sums[0]);
+  if (lag < 0) {
+    lag += 2 * M_PI;
+  }
+  tremor_response_t response = {
+    .gain = hypot(speed_sums[0], speed_sums[1]) / command_speed,
+    .delay_ms = lag / (2 * M_PI * hz) * 1000,
+  };
+  return response;
+}
+
+static void report(const char* name, step_response_t steps, tremor_response_t tremor) {
+  printf("%-9s peak acceleration %7.0f deg/s^2  settling %.2f s  tremor gain %.2f, %.1f ms behind\n",
+      name, steps.peak_acceleration, steps.settle_s, tremor.gain, tremor.delay_ms);
+}
+
+int main(int argc, char** argv) {
+  motion_config_t config = {
+    .max_velocity = 10000,
+    .max_acceleration = 300000,
+  };
+  float step = 486;
+  float amplitude = 80;
+  float tremor_hz = 8;
+  const char* out = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "v:a:s:t:A:f:o:")) != -1) {
+    switch (opt) {
+      case 'v': config.max_velocity = atof(optarg); break;
+      case 'a': config.max_acceleration = atof(optarg); break;
+      case 's': step = atof(optarg); break;
+      case 't': tau = atof(optarg); break;
+      case 'A': amplitude = atof(optarg); break;
+      case 'f': tremor_hz = atof(optarg); break;
+      case 'o': out = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-v velocity] [-a acceleration] [-s step] [-t tau] "
+            "[-A amplitude] [-f hz] [-o out.csv]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (config.max_velocity <= 0 || config.max_acceleration <= 0 || tau <= 0 || amplitude <= 0 ||
+      tremor_hz <= 0) {
+    fprintf(stderr, "limits and model parameters must be positive\n");
+    return 1;
+  }
+
+  // the stabilization pattern: one way, the other way through stop, stop
+  const float commands[] = {step, -step, step / 2, 0};
+  const int count = sizeof(commands) / sizeof(commands[0]);
+
+  FILE* csv = NULL;
+  if (out) {
+    csv = fopen(out, "w");
+    if (!csv) {
+      perror(out);
+      return 1;
+    }
+    fprintf(csv, "pattern,profiled,time_s,output_us,speed_dps\n");
+  }
+
+  printf("tremor command %.0f us at %.1f Hz, servo time constant %.0f ms\n", amplitude, tremor_hz, tau * 1000);
+  report("direct", simulate_steps(commands, count, NULL, csv, 0),
+      simulate_tremor(amplitude, tremor_hz, NULL, csv, 0));
+  report("profiled", simulate_steps(commands, count, &config, csv, 1),
+      simulate_tremor(amplitude, tremor_hz, &config, csv, 1));
+
+  // cost of one profile step
+  motion_profile_t profile;
+  motion_init(&profile, &config, FRAME_S, 0);
+  const int iterations = 10000000;
+  volatile float sink = 0;
+  clock_t start = clock();
+  for (int i = 0; i < iterations; i++) {
+    sink = motion_update(&profile, (i & 64) ? step : -step);
+  }
+  (void)sink;
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("motion_update: %.1f ns\n", seconds * 1e9 / iterations);
+
+  if (csv) {
+    fclose(csv);
+  }
+  return 0;
+}
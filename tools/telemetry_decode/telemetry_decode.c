@@ -0,0 +1,93 @@
+// Binary telemetry decoder
+//
+// Turns a telemetry stream from libraries/telemetry back into CSV with
+// physical units, for example from a capture of the telemetry RTT channel:
+//  JLinkRTTLogger -Device NRF52832_XXAA -If SWD -Speed 4000 -RTTChannel 1 log.bin
+//  telemetry_decode log.bin > log.csv
+//
+// Timestamps are extended past the 32-bit counter wrap. Gaps in the sequence
+// numbers, from records dropped on the device or lost in capture, are
+// reported on stderr.
+//
+// Usage: telemetry_decode [log.bin]
+//  reads stdin without a file name
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "telemetry.h"
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [log.bin]\n", argv[0]);
+    return 1;
+  }
+  FILE* file = stdin;
+  if (argc == 2) {
+    file = fopen(argv[1], "rb");
+    if (!file) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  printf("time_s,sequence,gyro_x,gyro_y,gyro_z,accel_x,accel_y,accel_z,angle_x,angle_y,angle_z");
+  for (int i = 0; i < TELEMETRY_SERVOS; i++) {
+    printf(",tremor_%d", i);
+  }
+  for (int i = 0; i < TELEMETRY_SERVOS; i++) {
+    printf(",command_%d", i);
+  }
+  printf(",dropped\n");
+
+  telemetry_record_t record;
+  uint64_t records = 0;
+  uint64_t missing = 0;
+  uint64_t time_high = 0;
+  uint32_t last_time = 0;
+  uint16_t last_sequence = 0;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    if (records > 0) {
+      if (record.timestamp_us < last_time) {
+        time_high += (uint64_t)1 << 32;
+      }
+      uint16_t gap = record.sequence - last_sequence - 1;
+      if (gap != 0) {
+        fprintf(stderr, "# %u records missing before sequence %u\n", gap, record.sequence);
+        missing += gap;
+      }
+    }
+    last_time = record.timestamp_us;
+    last_sequence = record.sequence;
+    records++;
+
+    printf("%.6f,%u", (time_high + record.timestamp_us) / 1e6, record.sequence);
+    for (int i = 0; i < 3; i++) {
+      printf(",%.4f", record.gyro[i] / TELEMETRY_GYRO_SCALE);
+    }
+    for (int i = 0; i < 3; i++) {
+      printf(",%.4f", record.accel[i] / TELEMETRY_ACCEL_SCALE);
+    }
+    for (int i = 0; i < 3; i++) {
+      printf(",%.4f", record.angle[i] / TELEMETRY_ANGLE_SCALE);
+    }
+    for (int i = 0; i < TELEMETRY_SERVOS; i++) {
+      printf(",%d", (record.tremor >> i) & 1);
+    }
+    for (int i = 0; i < TELEMETRY_SERVOS; i++) {
+      printf(",%.4f", record.command[i] / TELEMETRY_COMMAND_SCALE);
+    }
+    printf(",%u\n", record.dropped);
+  }
+
+  if (ferror(file)) {
+    perror("read");
+    return 1;
+  }
+  fprintf(stderr, "# %" PRIu64 " records, %" PRIu64 " missing\n", records, missing);
+  if (file != stdin) {
+    fclose(file);
+  }
+  return 0;
+}
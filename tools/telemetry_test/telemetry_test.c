@@ -0,0 +1,273 @@
+// Binary telemetry ring and decoder test
+//
+// Runs libraries/telemetry on the host, where __DMB() is a compiler and
+// memory barrier, and checks:
+//  overflow - a full ring drops records, counts them, and still numbers them
+//  partial sink - a sink that takes only some records loses none, and the
+//   next drain resumes at the first one it refused
+//  ring wrap - records that straddle the end of the ring drain in order
+//  decoding - a stream through both the 32-bit timestamp and 16-bit sequence
+//   wraps, with one burst of drops, decodes with continuous time and exactly
+//   that many records reported missing by tools/telemetry_decode
+//
+// Usage: telemetry_test [decoder]
+//  decoder - telemetry_decode binary (default ../telemetry_decode/telemetry_decode)
+//  exits non-zero if any check fails
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "telemetry.h"
+
+#define STREAM_FILE "telemetry_test.bin"
+#define REPORT_FILE "telemetry_test.txt"
+
+// time between records, as the 20 ms control loop
+static const uint32_t PERIOD_US = 20000;
+
+static int failures = 0;
+
+static void check(bool ok, const char* name, const char* detail) {
+  printf("%s %s%s%s\n", ok ? "ok  " : "FAIL", name, ok ? "" : ": ", ok ? "" : detail);
+  if (!ok) {
+    failures++;
+  }
+}
+
+// sink collecting sequence numbers, accepting up to limit records per call
+static uint16_t received[4 * TELEMETRY_RING_SIZE];
+static uint32_t received_count = 0;
+static uint32_t sink_calls = 0;
+static uint32_t sink_limit = UINT32_MAX;
+
+static uint32_t collect_sink(const void* data, uint32_t length) {
+  const telemetry_record_t* records = data;
+  uint32_t count = length / sizeof(telemetry_record_t);
+  if (count > sink_limit) {
+    count = sink_limit;
+  }
+  for (uint32_t i = 0; i < count && received_count < sizeof(received) / sizeof(received[0]); i++) {
+    received[received_count++] = records[i].sequence;
+  }
+  sink_calls++;
+  return count * sizeof(telemetry_record_t);
+}
+
+static void collect_reset(uint32_t limit) {
+  received_count = 0;
+  sink_calls = 0;
+  sink_limit = limit;
+}
+
+// true if the collected sequence numbers count up by one from first
+static bool collected_in_order(uint16_t first, uint32_t count) {
+  if (received_count != count) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (received[i] != (uint16_t)(first + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static FILE* stream = NULL;
+
+static uint32_t file_sink(const void* data, uint32_t length) {
+  return fwrite(data, 1, length, stream);
+}
+
+// the next sequence number telemetry_write will assign
+static uint16_t next_sequence = 0;
+
+static bool write_record(uint32_t timestamp_us) {
+  telemetry_record_t record = {
+    .timestamp_us = timestamp_us,
+    .gyro = {telemetry_quantize(12.5, TELEMETRY_GYRO_SCALE), -16, 4000},
+    .accel = {1000, 0, -2000},
+    .tremor = 2,
+  };
+  next_sequence++;
+  return telemetry_write(&record);
+}
+
+static void test_overflow(void) {
+  const uint32_t extra = 5;
+  uint16_t first = next_sequence;
+  uint32_t dropped_before = telemetry_dropped();
+
+  uint32_t accepted = 0;
+  for (uint32_t i = 0; i < TELEMETRY_RING_SIZE + extra; i++) {
+    accepted += write_record(i * PERIOD_US);
+  }
+  check(accepted == TELEMETRY_RING_SIZE, "overflow accepts a full ring", "wrong number of records accepted");
+  check(telemetry_dropped() - dropped_before == extra, "overflow counts drops", "wrong dropped count");
+
+  collect_reset(UINT32_MAX);
+  uint32_t sent = telemetry_drain(collect_sink);
+  check(sent == TELEMETRY_RING_SIZE && collected_in_order(first, TELEMETRY_RING_SIZE),
+      "overflow keeps the oldest records", "drained records are not the first ring full");
+
+  // the next record carries the gap and the running count
+  collect_reset(UINT32_MAX);
+  write_record(0);
+  telemetry_drain(collect_sink);
+  check(received_count == 1 && received[0] == (uint16_t)(first + TELEMETRY_RING_SIZE + extra),
+      "overflow numbers dropped records", "sequence does not skip the dropped records");
+}
+
+static void test_partial_sink(void) {
+  const uint32_t count = TELEMETRY_RING_SIZE / 2;
+  uint16_t first = next_sequence;
+  for (uint32_t i = 0; i < count; i++) {
+    write_record(i * PERIOD_US);
+  }
+
+  // a full sink takes nothing and loses nothing
+  collect_reset(0);
+  check(telemetry_drain(collect_sink) == 0 && received_count == 0, "partial sink refused",
+      "records sent to a full sink");
+
+  // three records per call, one call per drain, resuming where it stopped
+  collect_reset(3);
+  uint32_t drains = 0;
+  while (received_count < count && drains < count) {
+    uint32_t sent = telemetry_drain(collect_sink);
+    if (sent != 3 && received_count != count) {
+      break;
+    }
+    drains++;
+  }
+  check(collected_in_order(first, count), "partial sink resumes", "records lost or repeated between drains");
+  check(telemetry_drain(collect_sink) == 0, "partial sink empties the ring", "records left after draining");
+}
+
+static void test_ring_wrap(void) {
+  // move the indices to three records before the end of the ring
+  uint32_t offset = (next_sequence - telemetry_dropped()) % TELEMETRY_RING_SIZE;
+  uint32_t skip = (TELEMETRY_RING_SIZE - 3 - offset) % TELEMETRY_RING_SIZE;
+  for (uint32_t i = 0; i < skip; i++) {
+    write_record(0);
+  }
+  collect_reset(UINT32_MAX);
+  telemetry_drain(collect_sink);
+
+  uint16_t first = next_sequence;
+  const uint32_t count = 10;
+  for (uint32_t i = 0; i < count; i++) {
+    write_record(i * PERIOD_US);
+  }
+  collect_reset(UINT32_MAX);
+  uint32_t sent = telemetry_drain(collect_sink);
+  check(sent == count && collected_in_order(first, count) && sink_calls == 2,
+      "ring wrap drains in order", "wrapped records out of order or not split at the ring end");
+}
+
+static void test_decoding(const char* decoder) {
+  // enough records to wrap the sequence number, starting before the
+  // timestamp wraps, with one burst of drops along the way
+  const uint32_t records = 70000;
+  const uint32_t drop_at = 1000;
+  const uint32_t drop_count = 7;
+  const uint32_t start_us = 0xFFFF0000;
+
+  stream = fopen(STREAM_FILE, "wb");
+  if (!stream) {
+    perror(STREAM_FILE);
+    failures++;
+    return;
+  }
+  uint32_t timestamp = start_us;
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < records; i++) {
+    if (i == drop_at) {
+      // fill the ring, then drop records while it is full
+      while (write_record(timestamp)) {
+        timestamp += PERIOD_US;
+        written++;
+      }
+      timestamp += PERIOD_US;
+      for (uint32_t j = 1; j < drop_count; j++) {
+        write_record(timestamp);
+        timestamp += PERIOD_US;
+      }
+      telemetry_drain(file_sink);
+    }
+    written += write_record(timestamp);
+    timestamp += PERIOD_US;
+    telemetry_drain(file_sink);
+  }
+  fclose(stream);
+
+  char command[512];
+  // the summary goes to stderr, kept apart so it cannot split a CSV line
+  snprintf(command, sizeof(command), "%s " STREAM_FILE " 2>" REPORT_FILE, decoder);
+  FILE* output = popen(command, "r");
+  if (!output) {
+    perror(decoder);
+    failures++;
+    return;
+  }
+
+  // time must advance by one period per record, plus the dropped ones
+  char line[512];
+  uint32_t rows = 0;
+  uint64_t missing = UINT64_MAX;
+  bool continuous = true;
+  double last_time = 0;
+  unsigned last_sequence = 0;
+  while (fgets(line, sizeof(line), output)) {
+    double time_s;
+    unsigned sequence;
+    if (sscanf(line, "%lf,%u,", &time_s, &sequence) != 2) {
+      continue;
+    }
+    if (rows > 0) {
+      uint16_t step = sequence - last_sequence;
+      double expected = last_time + step * PERIOD_US / 1e6;
+      if (fabs(time_s - expected) > 1e-5) {
+        continuous = false;
+      }
+    }
+    last_time = time_s;
+    last_sequence = sequence;
+    rows++;
+  }
+  int status = pclose(output);
+
+  FILE* report = fopen(REPORT_FILE, "r");
+  while (report && fgets(line, sizeof(line), report)) {
+    uint64_t count;
+    sscanf(line, "# %" SCNu64 " records, %" SCNu64 " missing", &count, &missing);
+  }
+  if (report) {
+    fclose(report);
+  }
+  remove(STREAM_FILE);
+  remove(REPORT_FILE);
+
+  check(status == 0 && rows == written, "decoding reads every record", "decoder failed or lost records");
+  check(continuous && last_time > 4294.967296, "decoding extends time past the wrap",
+      "timestamps jump at the 32-bit or sequence wrap");
+  check(missing == drop_count, "decoding reports the dropped records", "wrong missing count");
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [decoder]\n", argv[0]);
+    return 1;
+  }
+  const char* decoder = (argc == 2) ? argv[1] : "../telemetry_decode/telemetry_decode";
+
+  test_overflow();
+  test_partial_sink();
+  test_ring_wrap();
+  test_decoding(decoder);
+
+  printf("%d checks failed\n", failures);
+  return failures ? 1 : 0;
+}
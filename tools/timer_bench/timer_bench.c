@@ -0,0 +1,200 @@
+// Virtual timer queue benchmark
+//
+// Times the virtual timer library on the simulated clock backend with the
+// armed timers kept in the binary heap (timer_bench_heap) or in the sorted
+// linked list it replaced (timer_bench_list, see timer_list.c). Both builds
+// run the same virtual_timer.c, so the difference is the queue alone.
+//
+// For each timer count, that many repeated timers with random periods are
+// armed and then:
+//  - expire: simulated time runs until EXPIRATIONS callbacks have fired.
+//    Each one is a compare interrupt that pops the first timer and requeues
+//    it a period later
+//  - restart: a random armed timer is cancelled and a new one started, as
+//    the control loop does when it reschedules work
+// The mean host time per operation is reported. The operations are then
+// repeated with the simulated backend timing each stretch the timer
+// interrupt is held off, the compare handler runs (which are the timer
+// interrupt on hardware) while expiring and the critical sections while
+// restarting, and the 99.9th percentile and longest of those are reported.
+// Absolute numbers are for the host, but they scale with the length of the
+// IRQ-disabled sections on the nRF52. Each timed section includes one host
+// clock read, and the longest also catches host interrupts and scheduling,
+// which the percentile leaves out.
+//
+// Usage: timer_bench [-n operations] [timers...]
+//  -n  expirations and restarts per timer count (default 1000000)
+//  timer counts default to 4 32 256
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "virtual_timer.h"
+#include "virtual_timer_hal_sim.h"
+#include "virtual_timer_heap.h"
+
+// repeated timer periods, microseconds
+static const uint32_t MIN_PERIOD_US = 1000;
+static const uint32_t MAX_PERIOD_US = 100000;
+
+static uint32_t expirations = 0;
+
+static void timer_callback(void) {
+  expirations++;
+}
+
+static uint32_t random_period(void) {
+  return MIN_PERIOD_US + (uint32_t)rand() % (MAX_PERIOD_US - MIN_PERIOD_US + 1);
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// lengths of the sections the timer interrupt is held off for, in
+// SECTION_BUCKET_NS buckets. The last bucket collects everything longer
+#define SECTION_BUCKETS 1000
+#define SECTION_BUCKET_NS 10
+
+typedef struct {
+  uint32_t count;
+  uint32_t max_ns;
+  uint32_t buckets[SECTION_BUCKETS];
+} sections_t;
+
+static sections_t sections;
+
+static void section_callback(uint32_t nanoseconds) {
+  uint32_t bucket = nanoseconds / SECTION_BUCKET_NS;
+  sections.buckets[(bucket < SECTION_BUCKETS) ? bucket : SECTION_BUCKETS - 1]++;
+  sections.count++;
+  if (nanoseconds > sections.max_ns) {
+    sections.max_ns = nanoseconds;
+  }
+}
+
+// start timing sections, or stop when timed is false
+static void sections_start(bool timed) {
+  memset(&sections, 0, sizeof(sections));
+  virtual_timer_sim_time_sections(timed ? section_callback : NULL);
+}
+
+// upper bound on the 99.9th percentile section, in nanoseconds
+static uint32_t sections_p999(void) {
+  uint64_t target = ((uint64_t)sections.count * 999 + 999) / 1000;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < SECTION_BUCKETS - 1; i++) {
+    seen += sections.buckets[i];
+    if (seen >= target) {
+      uint32_t upper = (i + 1) * SECTION_BUCKET_NS - 1;
+      return (upper < sections.max_ns) ? upper : sections.max_ns;
+    }
+  }
+  return sections.max_ns;
+}
+
+// host nanoseconds for one timer count
+typedef struct {
+  double expire_ns;          // mean per expiration
+  double restart_ns;         // mean per cancel-and-restart
+  uint32_t expire_p999_ns;   // compare handler runs
+  uint32_t expire_max_ns;
+  uint32_t restart_p999_ns;  // critical sections and any handler runs
+  uint32_t restart_max_ns;
+} result_t;
+
+// benchmark one timer count. With timed set, the backend also times each
+// section, which slows every operation down, so the means are only
+// meaningful from an untimed run
+static void run(uint32_t timers, uint32_t operations, bool timed, result_t* result) {
+  srand(1);
+  virtual_timer_init();
+
+  uint32_t ids[VIRTUAL_TIMER_MAX_TIMERS];
+  for (uint32_t i = 0; i < timers; i++) {
+    ids[i] = virtual_timer_start_repeated(random_period(), timer_callback);
+  }
+
+  expirations = 0;
+  sections_start(timed);
+  double start = now_ns();
+  while (expirations < operations) {
+    virtual_timer_idle();
+  }
+  result->expire_ns = (now_ns() - start) / expirations;
+  result->expire_p999_ns = sections_p999();
+  result->expire_max_ns = sections.max_ns;
+
+  // draw the random choices up front so only the timer calls are timed
+  uint32_t* picks = malloc(operations * sizeof(uint32_t));
+  uint32_t* periods = malloc(operations * sizeof(uint32_t));
+  for (uint32_t i = 0; i < operations; i++) {
+    picks[i] = (uint32_t)rand() % timers;
+    periods[i] = random_period();
+  }
+  sections_start(timed);
+  start = now_ns();
+  for (uint32_t i = 0; i < operations; i++) {
+    virtual_timer_cancel(ids[picks[i]]);
+    ids[picks[i]] = virtual_timer_start_repeated(periods[i], timer_callback);
+  }
+  result->restart_ns = (now_ns() - start) / operations;
+  result->restart_p999_ns = sections_p999();
+  result->restart_max_ns = sections.max_ns;
+  sections_start(false);
+  free(picks);
+  free(periods);
+
+  for (uint32_t i = 0; i < timers; i++) {
+    virtual_timer_cancel(ids[i]);
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t operations = 1000000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+      case 'n': operations = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-n operations] [timers...]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  uint32_t counts[16] = {4, 32, 256};
+  uint32_t num_counts = 3;
+  if (optind < argc) {
+    num_counts = 0;
+    for (int i = optind; i < argc && num_counts < 16; i++) {
+      counts[num_counts++] = strtoul(argv[i], NULL, 0);
+    }
+  }
+
+  printf("%s queue, %" PRIu32 " operations per count\n", QUEUE_NAME, operations);
+  printf("        ------ expire (ns) -----  ----- restart (ns) -----\n");
+  printf("timers    mean  p99.9       max    mean  p99.9       max\n");
+  for (uint32_t i = 0; i < num_counts; i++) {
+    if (counts[i] == 0 || counts[i] > VIRTUAL_TIMER_MAX_TIMERS) {
+      fprintf(stderr, "timer count must be 1 to %d\n", VIRTUAL_TIMER_MAX_TIMERS);
+      return 1;
+    }
+    result_t untimed;
+    result_t timed;
+    run(counts[i], operations, false, &untimed);
+    run(counts[i], operations, true, &timed);
+    printf("%6" PRIu32 "  %6.1f  %5" PRIu32 "  %8" PRIu32 "  %6.1f  %5" PRIu32 "  %8" PRIu32 "\n", counts[i],
+        untimed.expire_ns, timed.expire_p999_ns, timed.expire_max_ns,
+        untimed.restart_ns, timed.restart_p999_ns, timed.restart_max_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Sorted linked list timer queue for the timer benchmark
+//
+// The queue the virtual timer used before the heap: singly linked, kept
+// sorted by `timer_value`, O(n) insert and remove. It implements the heap
+// interface from virtual_timer_heap.h so virtual_timer.c runs unchanged on
+// top of it. node_t has no link field, so links live in a side table and
+// each node's heap_index holds its slot in that table.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "virtual_timer_heap.h"
+
+#define NO_SLOT 0xFFFF
+
+typedef struct {
+    node_t* node;
+    uint16_t next;
+} link_t;
+
+// the linked list
+static link_t links[VIRTUAL_TIMER_MAX_TIMERS];
+static uint16_t list_head = NO_SLOT;
+static uint16_t list_count = 0;
+
+// unused link slots
+static uint16_t free_slots[VIRTUAL_TIMER_MAX_TIMERS];
+static uint16_t free_count = 0;
+static bool slots_ready = false;
+
+static void init_slots(void) {
+    for (uint16_t i = 0; i < VIRTUAL_TIMER_MAX_TIMERS; i++) {
+        free_slots[i] = i;
+        links[i].node = NULL;
+    }
+    free_count = VIRTUAL_TIMER_MAX_TIMERS;
+    slots_ready = true;
+}
+
+static void release_slot(uint16_t slot) {
+    links[slot].node->heap_index = NO_SLOT;
+    links[slot].node = NULL;
+    free_slots[free_count++] = slot;
+    list_count--;
+}
+
+
+// -- External functions
+
+// insert item into list sorted by `timer_value`, after any equal values
+bool heap_insert(node_t* node) {
+    if (!slots_ready) {
+        init_slots();
+    }
+    if (node == NULL || free_count == 0) {
+        return false;
+    }
+
+    uint16_t slot = free_slots[--free_count];
+    links[slot].node = node;
+    node->heap_index = slot;
+    list_count++;
+
+    if (list_head == NO_SLOT || timer_before(node->timer_value, links[list_head].node->timer_value)) {
+        // node is new head
+        links[slot].next = list_head;
+        list_head = slot;
+        return true;
+    }
+
+    // node is somewhere after the head
+    uint16_t prev = list_head;
+    uint16_t curr = links[list_head].next;
+    while (curr != NO_SLOT && !timer_before(node->timer_value, links[curr].node->timer_value)) {
+        prev = curr;
+        curr = links[curr].next;
+    }
+    links[prev].next = slot;
+    links[slot].next = curr;
+    return true;
+}
+
+// return first element without removing
+node_t* heap_get_first() {
+    if (list_head == NO_SLOT) {
+        return NULL;
+    }
+    return links[list_head].node;
+}
+
+// remove and return first element
+node_t* heap_remove_first() {
+    if (list_head == NO_SLOT) {
+        return NULL;
+    }
+    uint16_t slot = list_head;
+    node_t* head = links[slot].node;
+    list_head = links[slot].next;
+    release_slot(slot);
+    return head;
+}
+
+// remove an arbitrary node if in list, searching for its predecessor
+void heap_remove(node_t* node) {
+    if (!heap_contains(node)) {
+        return;
+    }
+    uint16_t slot = node->heap_index;
+    if (list_head == slot) {
+        list_head = links[slot].next;
+    } else {
+        uint16_t prev = list_head;
+        while (links[prev].next != slot) {
+            prev = links[prev].next;
+        }
+        links[prev].next = links[slot].next;
+    }
+    release_slot(slot);
+}
+
+bool heap_contains(node_t* node) {
+    return node != NULL && node->heap_index < VIRTUAL_TIMER_MAX_TIMERS && links[node->heap_index].node == node;
+}
+
+uint16_t heap_size() {
+    return list_count;
+}
+
+// print contents of list
+void heap_print() {
+    if (list_head == NO_SLOT) {
+        printf("[ EMPTY ]\n");
+        return;
+    }
+    printf("[ (%" PRIu32 ")", links[list_head].node->timer_value);
+    for (uint16_t slot = links[list_head].next; slot != NO_SLOT; slot = links[slot].next) {
+        printf(" -> (%" PRIu32 ")", links[slot].node->timer_value);
+    }
+    printf(" ]\n");
+}
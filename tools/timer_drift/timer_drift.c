@@ -0,0 +1,147 @@
+// Virtual timer wrap and drift check
+//
+// Runs repeated timers on the simulated clock backend, starting just before
+// the 32-bit counter wraps, and checks that the k-th callback of a timer
+// with period P started at S runs at S + k*P plus no more than the latency
+// of the callbacks ahead of it. Deadlines advance by exact multiples of the
+// period, so that error must stay bounded however long the run is. Any
+// drift would grow with k until it fails the check.
+//
+// One timer has a slow callback that holds the interrupt, so the others are
+// regularly late and have to catch up without moving their phase. One
+// timer is deferred and runs from the main loop.
+//
+// Usage: timer_drift [-n periods] [-s start_us]
+//  -n  periods of the slowest timer to run (default 10000)
+//  -s  counter value at the start (default 0xFFFF0000, 65 ms before the wrap)
+//  exits non-zero if any callback is missing or off its phase
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "virtual_timer.h"
+#include "virtual_timer_hal_sim.h"
+
+// time the slow callback holds the interrupt
+static const uint32_t SLOW_CALLBACK_US = 300;
+
+typedef struct {
+  const char* name;
+  uint32_t period_us;
+  bool deferred;
+  bool slow;
+
+  uint64_t start;
+  uint64_t count;
+  uint64_t max_late;
+  uint64_t failures;
+} drift_timer_t;
+
+static drift_timer_t timers[] = {
+  {"20 ms", 20000, false, false, 0, 0, 0, 0},
+  {"1 ms slow", 1000, false, true, 0, 0, 0, 0},
+  {"997 us", 997, false, false, 0, 0, 0, 0},
+  {"3333 us deferred", 3333, true, false, 0, 0, 0, 0},
+};
+#define NUM_TIMERS (sizeof(timers) / sizeof(timers[0]))
+
+// latest any callback may run after its deadline: every other callback
+// that can be due at the same moment runs first
+static uint64_t late_bound = 0;
+
+static void record(drift_timer_t* timer) {
+  uint64_t now = read_timer64();
+  timer->count++;
+  uint64_t deadline = timer->start + timer->count * timer->period_us;
+  if (now < deadline || now - deadline > late_bound) {
+    if (timer->failures == 0) {
+      printf("FAIL %s: callback %" PRIu64 " at %" PRIu64 ", deadline %" PRIu64 "\n",
+          timer->name, timer->count, now, deadline);
+    }
+    timer->failures++;
+  } else if (now - deadline > timer->max_late) {
+    timer->max_late = now - deadline;
+  }
+  if (timer->slow) {
+    virtual_timer_sim_advance(SLOW_CALLBACK_US);
+  }
+}
+
+static void callback_0(void) { record(&timers[0]); }
+static void callback_1(void) { record(&timers[1]); }
+static void callback_2(void) { record(&timers[2]); }
+static void callback_3(void) { record(&timers[3]); }
+static const virtual_timer_callback_t callbacks[NUM_TIMERS] = {callback_0, callback_1, callback_2, callback_3};
+
+int main(int argc, char** argv) {
+  uint32_t periods = 10000;
+  uint32_t start_us = 0xFFFF0000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+    switch (opt) {
+      case 'n': periods = strtoul(optarg, NULL, 0); break;
+      case 's': start_us = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-n periods] [-s start_us]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  virtual_timer_init();
+  virtual_timer_sim_set_time(start_us);
+
+  uint32_t slowest = 0;
+  for (uint32_t i = 0; i < NUM_TIMERS; i++) {
+    late_bound += timers[i].slow ? SLOW_CALLBACK_US : 0;
+    if (timers[i].period_us > slowest) {
+      slowest = timers[i].period_us;
+    }
+  }
+
+  uint32_t ids[NUM_TIMERS];
+  for (uint32_t i = 0; i < NUM_TIMERS; i++) {
+    timers[i].start = read_timer64();
+    if (timers[i].deferred) {
+      ids[i] = virtual_timer_start_repeated_deferred(timers[i].period_us, callbacks[i]);
+    } else {
+      ids[i] = virtual_timer_start_repeated(timers[i].period_us, callbacks[i]);
+    }
+  }
+
+  uint64_t end = read_timer64() + (uint64_t)periods * slowest;
+  uint32_t wrapped_at = 0;
+  while (read_timer64() < end) {
+    virtual_timer_dispatch();
+    uint32_t before = read_timer();
+    virtual_timer_idle();
+    if (read_timer() < before && wrapped_at == 0) {
+      wrapped_at = read_timer();
+    }
+  }
+  virtual_timer_dispatch();
+  for (uint32_t i = 0; i < NUM_TIMERS; i++) {
+    virtual_timer_cancel(ids[i]);
+  }
+
+  uint64_t finish = read_timer64();
+  printf("start 0x%08" PRIx32 ", %" PRIu64 " us simulated, counter wrapped: %s\n",
+      start_us, finish - timers[0].start, wrapped_at ? "yes" : "no");
+  printf("timer             callbacks  deadlines  max_late_us\n");
+  int failed = 0;
+  for (uint32_t i = 0; i < NUM_TIMERS; i++) {
+    drift_timer_t* timer = &timers[i];
+    // the last deadline may have passed while its callback was held back
+    // behind the slow one
+    uint64_t deadlines = (finish - timer->start) / timer->period_us;
+    bool ok = timer->failures == 0 && (timer->count == deadlines || timer->count + 1 == deadlines);
+    printf("%-16s  %9" PRIu64 "  %9" PRIu64 "  %11" PRIu64 "%s\n", timer->name, timer->count, deadlines,
+        timer->max_late, ok ? "" : "  FAIL");
+    failed |= !ok;
+  }
+  return failed;
+}
@@ -0,0 +1,303 @@
+// Virtual timer randomized stress test
+//
+// Drives the virtual timer library on the simulated clock backend with a
+// random mix of one-shot, repeated, deferred, and slack timers being
+// started, cancelled (including by stale IDs), rescheduled, and expiring,
+// and checks every callback against a shadow model of what should be armed:
+//  - interrupt callbacks run inside their slack window, never early or late
+//  - deferred callbacks run after their window opens and before the next
+//    dispatch
+//  - nothing runs after it was cancelled, and no one-shot runs twice
+//  - no interrupt timer passes its window without running
+//  - every node is back in the pool once all timers are cancelled
+//
+// Usage: timer_stress [-n steps] [-r seed] [-s start_us]
+//  -n  random operations to run (default 1000000)
+//  -r  random seed (default 1)
+//  -s  counter value at the start (default 0xFFF00000, about a second
+//      before the counter wraps)
+//  exits non-zero on the first violation
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "virtual_timer.h"
+#include "virtual_timer_hal_sim.h"
+#include "virtual_timer_heap.h"
+
+// Timers in the model, each with its own callback
+#define SLOTS 24
+
+// The first DEFERRED_SLOTS slots may hold deferred timers. With their
+// periods longer than a step, each expires at most once per step, so the
+// deferred queue cannot overrun between dispatches
+#define DEFERRED_SLOTS 8
+
+// longest time advanced in one step, microseconds
+static const uint32_t MAX_STEP_US = 2000;
+
+typedef struct {
+  bool armed;
+  uint32_t id;
+  bool repeated;
+  bool deferred;
+  uint32_t period_us;
+  uint32_t slack_us;
+  // current window, in 64-bit time
+  uint64_t open;
+  uint64_t close;
+  uint64_t fired;
+} slot_t;
+
+static slot_t slots[SLOTS];
+
+// IDs of timers that expired or were cancelled, to cancel again
+#define STALE_IDS 64
+static uint32_t stale_ids[STALE_IDS];
+static uint32_t stale_count = 0;
+
+static uint64_t steps_run = 0;
+static uint64_t callbacks = 0;
+static uint64_t starts = 0;
+static uint64_t cancels = 0;
+static uint64_t reschedules = 0;
+
+static void fail(uint32_t index, const char* reason) {
+  const slot_t* slot = &slots[index];
+  printf("FAIL step %" PRIu64 " at %" PRIu64 ": slot %" PRIu32 " %s\n", steps_run, read_timer64(), index, reason);
+  printf("  id %08" PRIx32 " %s%s period %" PRIu32 " slack %" PRIu32 " window %" PRIu64 "-%" PRIu64 " fired %" PRIu64 "\n",
+      slot->id, slot->repeated ? "repeated" : "one-shot", slot->deferred ? " deferred" : "", slot->period_us,
+      slot->slack_us, slot->open, slot->close, slot->fired);
+  exit(1);
+}
+
+static void retire(uint32_t index) {
+  slots[index].armed = false;
+  stale_ids[stale_count % STALE_IDS] = slots[index].id;
+  stale_count++;
+}
+
+static uint32_t random_below(uint32_t limit) {
+  return (uint32_t)rand() % limit;
+}
+
+static void cancel_slot(uint32_t index) {
+  virtual_timer_cancel(slots[index].id);
+  retire(index);
+  cancels++;
+}
+
+static void on_callback(uint32_t index) {
+  slot_t* slot = &slots[index];
+  uint64_t now = read_timer64();
+  callbacks++;
+  if (!slot->armed) {
+    fail(index, "ran while not armed");
+  }
+  if (now < slot->open) {
+    fail(index, "ran before its window opened");
+  }
+  if (!slot->deferred && now > slot->close) {
+    fail(index, "ran after its window closed");
+  }
+  if (slot->deferred && now > slot->close + MAX_STEP_US) {
+    fail(index, "deferred callback was not dispatched in time");
+  }
+  slot->fired++;
+
+  if (!slot->repeated) {
+    retire(index);
+    return;
+  }
+
+  // the handler advances repeated deadlines by whole periods past the time
+  // it ran. Deferred callbacks run later, so only the first window is
+  // tracked exactly for them
+  if (!slot->deferred) {
+    do {
+      slot->close += slot->period_us;
+    } while (slot->close <= now);
+    slot->open = slot->close - slot->slack_us;
+  } else {
+    slot->open = 0;
+    slot->close = UINT64_MAX - MAX_STEP_US;
+  }
+
+  // callbacks may cancel timers, including themselves
+  if (random_below(16) == 0) {
+    cancel_slot(index);
+  }
+}
+
+#define SLOT_CALLBACK(n) static void callback_##n(void) { on_callback(n); }
+SLOT_CALLBACK(0) SLOT_CALLBACK(1) SLOT_CALLBACK(2) SLOT_CALLBACK(3) SLOT_CALLBACK(4) SLOT_CALLBACK(5)
+SLOT_CALLBACK(6) SLOT_CALLBACK(7) SLOT_CALLBACK(8) SLOT_CALLBACK(9) SLOT_CALLBACK(10) SLOT_CALLBACK(11)
+SLOT_CALLBACK(12) SLOT_CALLBACK(13) SLOT_CALLBACK(14) SLOT_CALLBACK(15) SLOT_CALLBACK(16) SLOT_CALLBACK(17)
+SLOT_CALLBACK(18) SLOT_CALLBACK(19) SLOT_CALLBACK(20) SLOT_CALLBACK(21) SLOT_CALLBACK(22) SLOT_CALLBACK(23)
+
+static const virtual_timer_callback_t slot_callbacks[SLOTS] = {
+  callback_0, callback_1, callback_2, callback_3, callback_4, callback_5,
+  callback_6, callback_7, callback_8, callback_9, callback_10, callback_11,
+  callback_12, callback_13, callback_14, callback_15, callback_16, callback_17,
+  callback_18, callback_19, callback_20, callback_21, callback_22, callback_23,
+};
+
+static void start_slot(uint32_t index) {
+  slot_t* slot = &slots[index];
+  slot->deferred = index < DEFERRED_SLOTS && random_below(2);
+  slot->repeated = random_below(2);
+  // deferred periods stay longer than a step, see DEFERRED_SLOTS
+  uint32_t min_us = slot->deferred ? 2 * MAX_STEP_US : (slot->repeated ? 50 : 0);
+  slot->period_us = min_us + random_below(20000);
+  slot->slack_us = random_below(4) == 0 ? random_below(slot->period_us / 2 + 1) : 0;
+
+  // a timer that is already due runs before the start call returns, so the
+  // model has to be updated first
+  uint32_t flags = (slot->repeated ? VIRTUAL_TIMER_REPEATED : 0) | (slot->deferred ? VIRTUAL_TIMER_DEFERRED : 0);
+  slot->armed = true;
+  slot->id = 0;
+  slot->fired = 0;
+  slot->open = read_timer64() + slot->period_us;
+  slot->close = slot->open + slot->slack_us;
+  uint32_t timer_id = virtual_timer_start_slack(slot->period_us, slot->slack_us, slot_callbacks[index], flags);
+  if (timer_id == 0) {
+    fail(index, "could not be started");
+  }
+  if (slot->armed) {
+    slot->id = timer_id;
+  }
+  starts++;
+}
+
+static void reschedule_slot(uint32_t index) {
+  slot_t* slot = &slots[index];
+  uint32_t min_us = slot->deferred ? 2 * MAX_STEP_US : (slot->repeated ? 50 : 0);
+  uint32_t microseconds = min_us + random_below(20000);
+  // a repeated timer cannot be given a zero period
+  if (slot->repeated && virtual_timer_reschedule(slot->id, 0)) {
+    fail(index, "was rescheduled to repeat with no period");
+  }
+  slot_t previous = *slot;
+  slot->period_us = microseconds;
+  slot->open = read_timer64() + microseconds;
+  slot->close = slot->open + slot->slack_us;
+  // a deferred timer that expired but was not dispatched yet cannot be
+  // moved, and there are none between steps
+  if (!virtual_timer_reschedule(previous.id, microseconds)) {
+    *slot = previous;
+    fail(index, "could not be rescheduled");
+  }
+  reschedules++;
+}
+
+// after time moves, every interrupt timer whose window has closed must
+// have run
+static void check_missed(void) {
+  uint64_t now = read_timer64();
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    if (slots[i].armed && !slots[i].deferred && now > slots[i].close) {
+      fail(i, "window closed without a callback");
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  uint64_t steps = 1000000;
+  unsigned seed = 1;
+  uint32_t start_us = 0xFFF00000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:s:")) != -1) {
+    switch (opt) {
+      case 'n': steps = strtoull(optarg, NULL, 0); break;
+      case 'r': seed = strtoul(optarg, NULL, 0); break;
+      case 's': start_us = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-n steps] [-r seed] [-s start_us]\n", argv[0]);
+        return 1;
+    }
+  }
+  srand(seed);
+
+  virtual_timer_init();
+  virtual_timer_sim_set_time(start_us);
+
+  // a repeated timer needs a period
+  if (virtual_timer_start_repeated(0, callback_0) != 0) {
+    fail(0, "started repeating with no period");
+  }
+
+  for (steps_run = 0; steps_run < steps; steps_run++) {
+    uint32_t index = random_below(SLOTS);
+    switch (random_below(8)) {
+      case 0:
+      case 1:
+        if (!slots[index].armed) {
+          start_slot(index);
+        }
+        break;
+      case 2:
+        if (slots[index].armed) {
+          cancel_slot(index);
+        }
+        break;
+      case 3:
+        // stale IDs must not touch the timers that reused their nodes
+        if (stale_count > 0) {
+          virtual_timer_cancel(stale_ids[random_below(stale_count < STALE_IDS ? stale_count : STALE_IDS)]);
+          if (virtual_timer_reschedule(stale_ids[random_below(stale_count < STALE_IDS ? stale_count : STALE_IDS)], 100)) {
+            fail(index, "stale ID was rescheduled");
+          }
+        }
+        break;
+      case 4:
+        if (slots[index].armed) {
+          reschedule_slot(index);
+        }
+        break;
+      default:
+        virtual_timer_sim_advance(random_below(MAX_STEP_US + 1));
+        check_missed();
+        virtual_timer_dispatch();
+        break;
+    }
+  }
+
+  if (virtual_timer_overruns() != 0) {
+    printf("FAIL deferred queue overran %" PRIu32 " times\n", virtual_timer_overruns());
+    return 1;
+  }
+
+  // everything cancelled must leave the queue empty and the pool full
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    if (slots[i].armed) {
+      cancel_slot(i);
+    }
+  }
+  virtual_timer_dispatch();
+  if (heap_size() != 0) {
+    printf("FAIL %u nodes left in the heap\n", heap_size());
+    return 1;
+  }
+  uint32_t pool[VIRTUAL_TIMER_MAX_TIMERS];
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_MAX_TIMERS; i++) {
+    pool[i] = virtual_timer_start(1000, callback_0);
+    if (pool[i] == 0) {
+      printf("FAIL only %" PRIu32 " of %d nodes returned to the pool\n", i, VIRTUAL_TIMER_MAX_TIMERS);
+      return 1;
+    }
+  }
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_MAX_TIMERS; i++) {
+    virtual_timer_cancel(pool[i]);
+  }
+
+  printf("%" PRIu64 " steps over %" PRIu64 " us: %" PRIu64 " starts, %" PRIu64 " cancels, %" PRIu64
+      " reschedules, %" PRIu64 " callbacks, %" PRIu32 " wakeups\n",
+      steps, read_timer64() - start_us, starts, cancels, reschedules, callbacks, virtual_timer_wakeups());
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Virtual timer wakeup coalescing measurement
+//
+// Runs a mix of periodic timers on the simulated clock backend twice, once
+// with exact deadlines and once with each timer allowed to fire up to a
+// share of its period late, and reports the callbacks run and the compare
+// interrupts (wakeups) it took to run them. Timers whose slack windows
+// overlap share one interrupt, so the callbacks stay the same while the
+// wakeups drop.
+//
+// Usage: timer_wakeups [-d seconds] [-k slack_percent] [period_ms...]
+//  -d  simulated duration (default 10)
+//  -k  slack as a percentage of each period (default 25)
+//  periods default to 20 33 50 100 250 ms
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "virtual_timer.h"
+#include "virtual_timer_hal_sim.h"
+
+#define MAX_PERIODS 16
+
+static uint32_t callbacks = 0;
+
+static void timer_callback(void) {
+  callbacks++;
+}
+
+// run the mix for seconds with the given slack, returning the wakeups
+static uint32_t run(const uint32_t* periods_ms, uint32_t count, uint32_t slack_percent, uint32_t seconds) {
+  virtual_timer_init();
+  callbacks = 0;
+
+  uint32_t ids[MAX_PERIODS];
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t period_us = periods_ms[i] * 1000;
+    ids[i] = virtual_timer_start_slack(period_us, period_us / 100 * slack_percent, timer_callback, VIRTUAL_TIMER_REPEATED);
+  }
+
+  uint64_t end = (uint64_t)seconds * 1000000;
+  while (read_timer64() < end) {
+    virtual_timer_idle();
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    virtual_timer_cancel(ids[i]);
+  }
+  return virtual_timer_wakeups();
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 10;
+  uint32_t slack_percent = 25;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:k:")) != -1) {
+    switch (opt) {
+      case 'd': seconds = strtoul(optarg, NULL, 0); break;
+      case 'k': slack_percent = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-d seconds] [-k slack_percent] [period_ms...]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  uint32_t periods_ms[MAX_PERIODS] = {20, 33, 50, 100, 250};
+  uint32_t count = 5;
+  if (optind < argc) {
+    count = 0;
+    for (int i = optind; i < argc && count < MAX_PERIODS; i++) {
+      periods_ms[count++] = strtoul(argv[i], NULL, 0);
+    }
+  }
+
+  printf("periods (ms):");
+  for (uint32_t i = 0; i < count; i++) {
+    printf(" %" PRIu32, periods_ms[i]);
+  }
+  printf(", %" PRIu32 " s simulated\n", seconds);
+  printf("slack  callbacks  wakeups\n");
+
+  uint32_t exact = run(periods_ms, count, 0, seconds);
+  uint32_t exact_callbacks = callbacks;
+  printf("%4d%%  %9" PRIu32 "  %7" PRIu32 "\n", 0, exact_callbacks, exact);
+
+  uint32_t coalesced = run(periods_ms, count, slack_percent, seconds);
+  printf("%4" PRIu32 "%%  %9" PRIu32 "  %7" PRIu32 "\n", slack_percent, callbacks, coalesced);
+
+  if (exact > 0) {
+    printf("%.1f%% fewer wakeups\n", 100.0 * (exact - coalesced) / exact);
+  }
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Tremor detector latency test
+//
+// Feeds the streaming tremor detector a synthetic gyro stream: slow
+// voluntary motion and sensor noise throughout, with a tremor burst switched
+// on and off in the middle. For each tremor frequency it reports how long
+// the detector takes to report the tremor after it starts and to release it
+// after it stops, and checks that the voluntary motion alone never
+// triggers it. Frequencies outside the detector band are reported but not
+// checked.
+//
+// Usage: tremor_detect_latency [-a tremor_dps] [-v voluntary_dps] [-n noise_dps]
+//                              [-l max_detect_s] [-r max_release_s] [frequency_hz...]
+//  -a  tremor amplitude (default 40)
+//  -v  amplitude of 0.5 Hz voluntary motion (default 60)
+//  -n  gaussian noise standard deviation (default 2)
+//  -l  longest detection latency that passes (default 0.5)
+//  -r  longest release latency that passes (default 1.0)
+//  frequencies default to 3 through 12 Hz
+//  exits non-zero if any frequency in the band fails
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tremor_detect.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// tremor burst, seconds
+static const float ONSET_S = 5.0;
+static const float OFFSET_S = 15.0;
+static const float DURATION_S = 20.0;
+
+static const float VOLUNTARY_HZ = 0.5;
+
+static float gaussian(void) {
+  // Box-Muller
+  float u1 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  float u2 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  return sqrtf(-2.0f * logf(u1)) * cosf(2 * M_PI * u2);
+}
+
+typedef struct {
+  bool false_positive;
+  float detect_s;  // negative if never detected
+  float release_s; // negative if never released
+  float peak_rms;
+} latency_result_t;
+
+static latency_result_t run(float tremor_hz, float tremor_dps, float voluntary_dps, float noise_dps) {
+  tremor_detect_config_t config = TREMOR_DETECT_DEFAULT_CONFIG;
+  tremor_detect_t detector;
+  tremor_detect_init(&detector, &config);
+  srand(1);
+
+  latency_result_t result = {false, -1, -1, 0};
+  uint32_t samples = DURATION_S * config.sample_rate_hz;
+  for (uint32_t i = 0; i < samples; i++) {
+    float t = i / config.sample_rate_hz;
+    float rate = voluntary_dps * sinf(2 * M_PI * VOLUNTARY_HZ * t) + noise_dps * gaussian();
+    bool tremor = t >= ONSET_S && t < OFFSET_S;
+    if (tremor) {
+      rate += tremor_dps * sinf(2 * M_PI * tremor_hz * (t - ONSET_S));
+    }
+
+    bool active = tremor_detect_update(&detector, rate);
+    if (tremor_detect_rms(&detector) > result.peak_rms) {
+      result.peak_rms = tremor_detect_rms(&detector);
+    }
+    if (t < ONSET_S && active) {
+      result.false_positive = true;
+    }
+    if (tremor && active && result.detect_s < 0) {
+      result.detect_s = t - ONSET_S;
+    }
+    if (t >= OFFSET_S && !active && result.release_s < 0) {
+      result.release_s = t - OFFSET_S;
+    }
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  float tremor_dps = 40;
+  float voluntary_dps = 60;
+  float noise_dps = 2;
+  float max_detect_s = 0.5;
+  float max_release_s = 1.0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "a:v:n:l:r:")) != -1) {
+    switch (opt) {
+      case 'a': tremor_dps = atof(optarg); break;
+      case 'v': voluntary_dps = atof(optarg); break;
+      case 'n': noise_dps = atof(optarg); break;
+      case 'l': max_detect_s = atof(optarg); break;
+      case 'r': max_release_s = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-a tremor_dps] [-v voluntary_dps] [-n noise_dps] [-l max_detect_s] [-r max_release_s] [frequency_hz...]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  float frequencies[32] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  int count = 10;
+  if (optind < argc) {
+    count = 0;
+    for (int i = optind; i < argc && count < 32; i++) {
+      frequencies[count++] = atof(argv[i]);
+    }
+  }
+
+  printf("tremor %.0f dps, voluntary %.0f dps at %.1f Hz, noise %.1f dps\n",
+      tremor_dps, voluntary_dps, VOLUNTARY_HZ, noise_dps);
+  printf("freq_hz  detect_s  release_s  peak_rms  false_positive\n");
+  tremor_detect_config_t config = TREMOR_DETECT_DEFAULT_CONFIG;
+  int failures = 0;
+  for (int i = 0; i < count; i++) {
+    latency_result_t result = run(frequencies[i], tremor_dps, voluntary_dps, noise_dps);
+    bool in_band = frequencies[i] >= config.low_hz && frequencies[i] <= config.high_hz;
+    bool ok = !result.false_positive
+        && result.detect_s >= 0 && result.detect_s <= max_detect_s
+        && result.release_s >= 0 && result.release_s <= max_release_s;
+    printf("%7.1f  %8.2f  %9.2f  %8.1f  %14s%s\n", frequencies[i], result.detect_s, result.release_s,
+        result.peak_rms, result.false_positive ? "yes" : "no", !in_band ? "  out of band" : (ok ? "" : "  FAIL"));
+    failures += in_band && !ok;
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+// Sliding DFT tremor frequency tracker benchmark
+//
+// Checks the fixed-point sliding DFT in libraries/tremor_freq and times it:
+//  - accuracy: pure tones across the band are read back through the
+//    interpolated peak, and the band power compared with A^2/2
+//  - drift: after a long run of random full-scale input, a window of zeros
+//    must return every bin to exactly zero
+//  - speed: host time per tremor_freq_update() call
+//
+// Usage: tremor_freq_bench [-r sample_rate_hz] [-n samples] [frequency_hz...]
+//  -r  sample rate (default 50, the control loop rate)
+//  -n  samples to time and to run the drift check over (default 200000)
+//  tone frequencies default to 4.3 6 8.77 11.2 Hz
+//  exits non-zero if a tone is off by more than 0.1 Hz or the bins drift
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tremor_freq.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// band tracked by servo_stabilization
+static const float LOW_HZ = 3.0;
+static const float HIGH_HZ = 15.0;
+
+static const float TONE_DPS = 40.0;
+static const float MAX_ERROR_HZ = 0.1;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+  float rate_hz = 50;
+  uint32_t samples = 200000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:n:")) != -1) {
+    switch (opt) {
+      case 'r': rate_hz = atof(optarg); break;
+      case 'n': samples = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-r sample_rate_hz] [-n samples] [frequency_hz...]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  float tones[32] = {4.3, 6.0, 8.77, 11.2};
+  int count = 4;
+  if (optind < argc) {
+    count = 0;
+    for (int i = optind; i < argc && count < 32; i++) {
+      tones[count++] = atof(argv[i]);
+    }
+  }
+
+  static tremor_freq_t tracker;
+  int failures = 0;
+
+  printf("%d sample window at %.0f Hz, %.2f Hz bins\n", TREMOR_FREQ_WINDOW, rate_hz, rate_hz / TREMOR_FREQ_WINDOW);
+  printf("tone_hz  peak_hz  error_hz  band_power  expected\n");
+  for (int i = 0; i < count; i++) {
+    tremor_freq_init(&tracker, rate_hz, LOW_HZ, HIGH_HZ);
+    for (uint32_t n = 0; n < 4 * TREMOR_FREQ_WINDOW; n++) {
+      tremor_freq_update(&tracker, TONE_DPS * sinf(2 * M_PI * tones[i] * n / rate_hz));
+    }
+    tremor_freq_result_t result = tremor_freq_result(&tracker);
+    float error = result.peak_hz - tones[i];
+    bool ok = tremor_freq_ready(&tracker) && fabsf(error) <= MAX_ERROR_HZ;
+    printf("%7.2f  %7.2f  %8.3f  %10.1f  %8.1f%s\n", tones[i], result.peak_hz, error, result.band_power,
+        TONE_DPS * TONE_DPS / 2, ok ? "" : "  FAIL");
+    failures += !ok;
+  }
+
+  // random full-scale input, timed, then a window of zeros
+  tremor_freq_init(&tracker, rate_hz, LOW_HZ, HIGH_HZ);
+  float* input = malloc(samples * sizeof(float));
+  srand(1);
+  for (uint32_t n = 0; n < samples; n++) {
+    input[n] = (rand() / (float)RAND_MAX * 2 - 1) * 2000;
+  }
+  double start = now_ns();
+  for (uint32_t n = 0; n < samples; n++) {
+    tremor_freq_update(&tracker, input[n]);
+  }
+  double update_ns = (now_ns() - start) / samples;
+  free(input);
+
+  for (uint32_t n = 0; n < TREMOR_FREQ_WINDOW; n++) {
+    tremor_freq_update(&tracker, 0);
+  }
+  int32_t residue = 0;
+  for (uint16_t bin = 0; bin < tracker.bin_count; bin++) {
+    residue |= tracker.real[bin] | tracker.imag[bin];
+  }
+  printf("%u bins, %.1f ns per update over %u samples\n", tracker.bin_count, update_ns, samples);
+  printf("bins after a window of zeros: %s\n", residue == 0 ? "exactly zero" : "nonzero  FAIL");
+  failures += residue != 0;
+
+  return failures ? 1 : 0;
+}
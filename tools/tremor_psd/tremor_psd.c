@@ -0,0 +1,218 @@
+// Tremor log spectral analysis
+//
+// Reads a CSV log written by apps/tremor_data (or any CSV of samples), and
+// prints the Welch averaged power spectral density of one column using the
+// same fixed-point FFT the firmware runs.
+//
+// Usage: tremor_psd [-c column] [-r rate_hz] [-n size] [-b] log.csv
+//  -c  zero based column to analyze (default 0)
+//  -r  sample rate of the log (default 10 Hz, the tremor_data logging rate)
+//  -n  FFT size, power of two up to SPECTRUM_MAX_SIZE (default 256)
+//  -b  also time the FFT pipeline per window, in host microseconds. The
+//      Cortex-M4 cycles of a 512 point window are in the servo_stabilization
+//      report
+//
+// The summary reports power in the 3-12 Hz tremor band, cut off at the
+// Nyquist frequency of the log with a warning when the rate is too low to
+// cover all of it
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "spectrum.h"
+
+// tremor band reported in the summary
+static const float BAND_LOW_HZ = 3.0;
+static const float BAND_HIGH_HZ = 12.0;
+
+// quantized samples use half of the int16 range, leaving headroom for windows
+// with a different mean than the whole log
+static const float FULL_SCALE = 16384.0;
+
+// read one column of a CSV file, skipping lines that do not parse
+static float* read_column(FILE* file, int column, size_t* count) {
+  size_t capacity = 1024;
+  float* values = malloc(capacity * sizeof(float));
+  char line[512];
+
+  *count = 0;
+  while (values && fgets(line, sizeof(line), file)) {
+    char* field = line;
+    for (int i = 0; i < column && field; i++) {
+      field = strchr(field, ',');
+      if (field) {
+        field++;
+      }
+    }
+    if (!field) {
+      continue;
+    }
+
+    char* end;
+    float value = strtof(field, &end);
+    if (end == field) {
+      continue;
+    }
+
+    if (*count == capacity) {
+      capacity *= 2;
+      float* grown = realloc(values, capacity * sizeof(float));
+      if (!grown) {
+        free(values);
+        return NULL;
+      }
+      values = grown;
+    }
+    values[(*count)++] = value;
+  }
+  return values;
+}
+
+// quantize a window after removing its mean
+static void quantize(const float* values, int16_t* samples, uint16_t n, float scale) {
+  float mean = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    mean += values[i];
+  }
+  mean /= n;
+  for (uint16_t i = 0; i < n; i++) {
+    float x = roundf((values[i] - mean) * scale);
+    samples[i] = (int16_t)fmaxf(fminf(x, INT16_MAX), INT16_MIN);
+  }
+}
+
+static void benchmark(const float* values, uint16_t n, float rate_hz, float scale) {
+  int16_t samples[SPECTRUM_MAX_SIZE];
+  float psd[SPECTRUM_MAX_SIZE / 2 + 1];
+  const int iterations = 100000;
+
+  clock_t start = clock();
+  for (int i = 0; i < iterations; i++) {
+    quantize(values, samples, n, scale);
+    spectrum_hann(samples, n);
+    spectrum_rfft(samples, n);
+    spectrum_psd(samples, n, rate_hz, scale, psd);
+  }
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  fprintf(stderr, "# %d point window: %.2f us\n", n, seconds * 1e6 / iterations);
+}
+
+int main(int argc, char** argv) {
+  int column = 0;
+  float rate_hz = 10.0;
+  int size = 256;
+  bool bench = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "c:r:n:b")) != -1) {
+    switch (opt) {
+      case 'c': column = atoi(optarg); break;
+      case 'r': rate_hz = atof(optarg); break;
+      case 'n': size = atoi(optarg); break;
+      case 'b': bench = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-c column] [-r rate_hz] [-n size] [-b] log.csv\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: %s [-c column] [-r rate_hz] [-n size] [-b] log.csv\n", argv[0]);
+    return 1;
+  }
+  if (size < 0 || size > UINT16_MAX || !spectrum_valid_size(size) || rate_hz <= 0) {
+    fprintf(stderr, "invalid FFT size or sample rate\n");
+    return 1;
+  }
+  uint16_t n = size;
+
+  FILE* file = fopen(argv[optind], "r");
+  if (!file) {
+    perror(argv[optind]);
+    return 1;
+  }
+  size_t count;
+  float* values = read_column(file, column, &count);
+  fclose(file);
+  if (!values) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  if (count < n) {
+    fprintf(stderr, "%zu samples, need at least %d\n", count, n);
+    free(values);
+    return 1;
+  }
+
+  // one quantization scale for the whole log keeps windows comparable
+  float mean = 0;
+  for (size_t i = 0; i < count; i++) {
+    mean += values[i];
+  }
+  mean /= count;
+  float peak = 0;
+  for (size_t i = 0; i < count; i++) {
+    peak = fmaxf(peak, fabsf(values[i] - mean));
+  }
+  float scale = (peak > 0) ? FULL_SCALE / peak : 1.0;
+
+  // Welch average over half overlapping windows
+  int16_t samples[SPECTRUM_MAX_SIZE];
+  float psd[SPECTRUM_MAX_SIZE / 2 + 1];
+  float average[SPECTRUM_MAX_SIZE / 2 + 1] = {0};
+  int windows = 0;
+  for (size_t start = 0; start + n <= count; start += n / 2) {
+    quantize(values + start, samples, n, scale);
+    spectrum_hann(samples, n);
+    spectrum_rfft(samples, n);
+    spectrum_psd(samples, n, rate_hz, scale, psd);
+    for (int k = 0; k <= n / 2; k++) {
+      average[k] += psd[k];
+    }
+    windows++;
+  }
+
+  // a log sampled below twice the top of the band only covers part of it.
+  // The 10 Hz tremor_data rate reaches 5 Hz
+  float band_high_hz = BAND_HIGH_HZ;
+  if (band_high_hz > rate_hz / 2) {
+    band_high_hz = rate_hz / 2;
+    fprintf(stderr, "# warning: the %.1f Hz Nyquist frequency of the log is below the top of the %.1f-%.1f Hz tremor band\n",
+        rate_hz / 2, BAND_LOW_HZ, BAND_HIGH_HZ);
+  }
+
+  float resolution = rate_hz / n;
+  float band_power = 0;
+  int peak_bin = 1;
+  printf("frequency_hz,psd\n");
+  for (int k = 0; k <= n / 2; k++) {
+    average[k] /= windows;
+    float hz = spectrum_bin_hz(k, n, rate_hz);
+    printf("%f,%g\n", hz, average[k]);
+    if (hz >= BAND_LOW_HZ && hz <= band_high_hz) {
+      band_power += average[k] * resolution;
+    }
+    if (k > 0 && average[k] > average[peak_bin]) {
+      peak_bin = k;
+    }
+  }
+
+  fprintf(stderr, "# %zu samples, %d windows of %d\n", count, windows, n);
+  fprintf(stderr, "# peak: %.3f Hz\n", spectrum_bin_hz(peak_bin, n, rate_hz));
+  if (BAND_LOW_HZ < band_high_hz) {
+    fprintf(stderr, "# %.1f-%.1f Hz band power: %g\n", BAND_LOW_HZ, band_high_hz, band_power);
+  } else {
+    fprintf(stderr, "# no band power: the log does not reach the %.1f Hz tremor band\n", BAND_LOW_HZ);
+  }
+  if (bench) {
+    benchmark(values, n, rate_hz, scale);
+  }
+
+  free(values);
+  return 0;
+}
@@ -0,0 +1,161 @@
+// WFLC tremor predictor benchmark
+//
+// Runs the weighted-frequency Fourier linear combiner on a synthetic 50 Hz
+// gyro stream and measures how well it tracks and predicts the tremor:
+//  - tremor with a second harmonic whose fundamental steps from 6 to 7.5 Hz
+//    halfway through, on top of slow voluntary motion and sensor noise
+//  - frequency error once settled on each side of the step, and the time
+//    to settle after it
+//  - RMS error of the tremor predicted -p ahead against the true tremor
+//    then, compared with holding the current tremor value, which is what
+//    driving the servo from the last sample amounts to
+//  - host time per wflc_update()
+//
+// Usage: wflc_bench [-p horizon_s] [-a tremor_dps] [-v voluntary_dps] [-n noise_dps]
+//  -p  prediction horizon (default 0.04, the servo latency in the app)
+//  -a  amplitude of the tremor fundamental (default 40)
+//  -v  amplitude of 0.4 Hz voluntary motion (default 60)
+//  -n  gaussian noise standard deviation (default 2)
+//  exits non-zero if the frequency does not settle within 0.1 Hz or the
+//  prediction is no better than a quarter of the hold error
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wflc.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const float STEP_S = 20.0;
+static const float DURATION_S = 40.0;
+static const float FIRST_HZ = 6.0;
+static const float SECOND_HZ = 7.5;
+static const float HARMONIC_SHARE = 0.25;
+static const float VOLUNTARY_HZ = 0.4;
+
+// time allowed to converge from start and after the step, excluded from
+// the error statistics
+static const float SETTLE_S = 5.0;
+static const float MAX_FREQUENCY_ERROR_HZ = 0.1;
+
+static float gaussian(void) {
+  // Box-Muller
+  float u1 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  float u2 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  return sqrtf(-2.0f * logf(u1)) * cosf(2 * M_PI * u2);
+}
+
+// tremor with a phase-continuous frequency step
+static float tremor_dps(float t, float amplitude) {
+  float phase = (t < STEP_S)
+      ? 2 * M_PI * FIRST_HZ * t
+      : 2 * M_PI * (FIRST_HZ * STEP_S + SECOND_HZ * (t - STEP_S));
+  return amplitude * (sinf(phase) + HARMONIC_SHARE * sinf(2 * phase + 0.7f));
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+  float horizon_s = 0.04;
+  float amplitude = 40;
+  float voluntary = 60;
+  float noise = 2;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:a:v:n:")) != -1) {
+    switch (opt) {
+      case 'p': horizon_s = atof(optarg); break;
+      case 'a': amplitude = atof(optarg); break;
+      case 'v': voluntary = atof(optarg); break;
+      case 'n': noise = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-p horizon_s] [-a tremor_dps] [-v voluntary_dps] [-n noise_dps]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  wflc_config_t config = WFLC_DEFAULT_CONFIG;
+  wflc_t filter;
+  wflc_init(&filter, &config);
+  srand(1);
+
+  uint32_t samples = DURATION_S * config.sample_rate_hz;
+  float* input = malloc(samples * sizeof(float));
+  for (uint32_t i = 0; i < samples; i++) {
+    float t = i / config.sample_rate_hz;
+    input[i] = tremor_dps(t, amplitude) + voluntary * sinf(2 * M_PI * VOLUNTARY_HZ * t) + noise * gaussian();
+  }
+
+  double frequency_error[2] = {0, 0};
+  uint32_t frequency_count[2] = {0, 0};
+  float settle_s = -1;
+  double predict_square = 0;
+  double hold_square = 0;
+  uint32_t error_count = 0;
+
+  for (uint32_t i = 0; i < samples; i++) {
+    float t = i / config.sample_rate_hz;
+    wflc_update(&filter, input[i]);
+
+    float truth_hz = t < STEP_S ? FIRST_HZ : SECOND_HZ;
+    float error_hz = fabsf(wflc_frequency_hz(&filter) - truth_hz);
+    if (t >= STEP_S && error_hz > MAX_FREQUENCY_ERROR_HZ) {
+      settle_s = -1;
+    } else if (t >= STEP_S && settle_s < 0) {
+      settle_s = t - STEP_S;
+    }
+
+    bool settled = (t >= SETTLE_S && t < STEP_S) || t >= STEP_S + SETTLE_S;
+    if (!settled) {
+      continue;
+    }
+    frequency_error[t >= STEP_S] += error_hz;
+    frequency_count[t >= STEP_S]++;
+
+    float future = tremor_dps(t + horizon_s, amplitude);
+    float predict_error = wflc_predict(&filter, horizon_s) - future;
+    float hold_error = tremor_dps(t, amplitude) - future;
+    predict_square += predict_error * predict_error;
+    hold_square += hold_error * hold_error;
+    error_count++;
+  }
+
+  // time the update on the same stream
+  wflc_init(&filter, &config);
+  double start = now_ns();
+  volatile float output = 0;
+  for (uint32_t i = 0; i < samples; i++) {
+    output = wflc_update(&filter, input[i]);
+  }
+  (void)output;
+  double update_ns = (now_ns() - start) / samples;
+  free(input);
+
+  float mean_error[2] = {frequency_error[0] / frequency_count[0], frequency_error[1] / frequency_count[1]};
+  float predict_rms = sqrt(predict_square / error_count);
+  float hold_rms = sqrt(hold_square / error_count);
+
+  printf("tremor %.0f dps at %.1f then %.1f Hz with a %.0f%% harmonic, voluntary %.0f dps, noise %.1f dps\n",
+      amplitude, FIRST_HZ, SECOND_HZ, HARMONIC_SHARE * 100, voluntary, noise);
+  printf("mean frequency error: %.3f Hz at %.1f Hz, %.3f Hz at %.1f Hz\n", mean_error[0], FIRST_HZ, mean_error[1], SECOND_HZ);
+  printf("settled within %.1f Hz %.2f s after the step\n", MAX_FREQUENCY_ERROR_HZ, settle_s);
+  printf("%.0f ms prediction error: %.1f dps RMS, holding the last value: %.1f dps RMS\n",
+      horizon_s * 1000, predict_rms, hold_rms);
+  printf("%.1f ns per update\n", update_ns);
+
+  bool ok = mean_error[0] < MAX_FREQUENCY_ERROR_HZ && mean_error[1] < MAX_FREQUENCY_ERROR_HZ
+      && settle_s >= 0 && predict_rms < hold_rms / 4;
+  printf("%s\n", ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}